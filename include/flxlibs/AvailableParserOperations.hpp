@@ -10,6 +10,11 @@
 #define FLXLIBS_INCLUDE_FLXLIBS_AVAILABLEPARSEROPERATIONS_HPP_
 
 #include "FelixIssues.hpp"
+#include "flxlibs/ChunkCopy.hpp"
+#include "flxlibs/ObjectPool.hpp"
+#include "flxlibs/ReservableSender.hpp"
+#include "flxlibs/SlabPool.hpp"
+#include "flxlibs/VariableSizePooledPayload.hpp"
 
 #include "iomanager/Sender.hpp"
 
@@ -41,228 +46,404 @@ print_bytes(std::ostream& ostr, const char* title, const unsigned char* data, st
   ostr << std::endl;
 }
 
-inline void
-dump_to_buffer(const char* data,
-               std::size_t size,
-               void* buffer,
-               uint32_t buffer_pos, // NOLINT
-               const std::size_t& buffer_size)
+// The chunk operations below never throw on a full sink: they try to send for the timeout (0 to not wait at
+// all), and then drop the payload. The ones returning bool return false on a drop, for the parser to count.
+// Their streaming_threshold is the one of copy_subchunks. The Chunk of the fixed size ones is
+// felix::packetformat::chunk, or any type with its length and subchunk accessors, e.g.: in the unit tests.
+
+template<class TargetStruct, class Chunk>
+inline bool
+fixsized_chunk_into(const Chunk& chunk,
+                    std::shared_ptr<iomanager::SenderConcept<TargetStruct>>& sink,
+                    std::chrono::milliseconds timeout,
+                    std::size_t streaming_threshold = 0)
 {
-  auto bytes_to_copy = size; // NOLINT
-  while (bytes_to_copy > 0) {
-    auto n = std::min(bytes_to_copy, buffer_size - buffer_pos); // NOLINT
-    std::memcpy(static_cast<char*>(buffer) + buffer_pos, data, n);
-    buffer_pos += n;
-    bytes_to_copy -= n;
-    if (buffer_pos == buffer_size) {
-      buffer_pos = 0;
-    }
+  // Chunk info
+  auto subchunk_data = chunk.subchunks();
+  auto subchunk_sizes = chunk.subchunk_lengths();
+  auto n_subchunks = chunk.subchunk_number();
+  std::size_t target_size = sizeof(TargetStruct);
+
+  // Only dump to buffer if possible
+  if (chunk.length() != target_size) {
+    ers::error(UnexpectedChunk(ERS_HERE, chunk.length(), target_size));
+  } else {
+    TargetStruct payload;
+    copy_subchunks(
+      static_cast<void*>(&payload.data), target_size, subchunk_data, subchunk_sizes, n_subchunks, streaming_threshold);
+    // finally, push to sink
+    return sink->try_send(std::move(payload), timeout);
   }
+  return true;
+}
+
+// Copies the chunk once, straight into the storage reserved in the sink
+template<class TargetStruct, class Chunk>
+inline bool
+fixsized_chunk_into_reserved(const Chunk& chunk,
+                             ReservableSender<TargetStruct>& sink,
+                             std::chrono::milliseconds timeout,
+                             std::size_t streaming_threshold = 0)
+{
+  std::size_t target_size = sizeof(TargetStruct);
+  if (chunk.length() != target_size) {
+    ers::error(UnexpectedChunk(ERS_HERE, chunk.length(), target_size));
+    return true;
+  }
+  TargetStruct* payload = sink.reserve(timeout);
+  if (payload == nullptr) {
+    return false;
+  }
+  auto subchunk_data = chunk.subchunks();
+  auto subchunk_sizes = chunk.subchunk_lengths();
+  auto n_subchunks = chunk.subchunk_number();
+  copy_subchunks(
+    static_cast<void*>(&payload->data), target_size, subchunk_data, subchunk_sizes, n_subchunks, streaming_threshold);
+  sink.commit();
+  return true;
 }
 
 template<class TargetStruct>
-inline std::function<void(const felix::packetformat::chunk& chunk)>
+inline std::function<bool(const felix::packetformat::chunk& chunk)>
 fixsizedChunkInto(std::shared_ptr<iomanager::SenderConcept<TargetStruct>>& sink,
                   std::chrono::milliseconds timeout = std::chrono::milliseconds(100))
 {
-  return [&](const felix::packetformat::chunk& chunk) {
-    // Chunk info
-    auto subchunk_data = chunk.subchunks();
-    auto subchunk_sizes = chunk.subchunk_lengths();
-    auto n_subchunks = chunk.subchunk_number();
-    std::size_t target_size = sizeof(TargetStruct);
-
-    // Only dump to buffer if possible
-    if (chunk.length() != target_size) {
-      ers::error(UnexpectedChunk(ERS_HERE, chunk.length(), target_size));
-    } else {
-      TargetStruct payload;
-      uint32_t bytes_copied_chunk = 0; // NOLINT
-      for (unsigned i = 0; i < n_subchunks; i++) {
-        dump_to_buffer(
-          subchunk_data[i], subchunk_sizes[i], static_cast<void*>(&payload.data), bytes_copied_chunk, target_size);
-        bytes_copied_chunk += subchunk_sizes[i];
-      }
-      try {
-        // finally, push to sink
-        sink->send(std::move(payload), timeout);
-      } catch (const dunedaq::iomanager::TimeoutExpired& excpt) {
-        // ers::error(ParserOperationQueuePushFailure(ERS_HERE, " "));
-      }
-    }
+  return [&sink, timeout](const felix::packetformat::chunk& chunk) {
+    return fixsized_chunk_into(chunk, sink, timeout);
   };
 }
 
 template<class TargetStruct>
-inline std::function<void(const felix::packetformat::shortchunk& shortchunk)>
+inline std::function<bool(const felix::packetformat::shortchunk& shortchunk)>
 fixsizedShortchunkInto(std::shared_ptr<iomanager::SenderConcept<TargetStruct>>& sink,
                        std::chrono::milliseconds timeout = std::chrono::milliseconds(100))
 {
-  return [&](const felix::packetformat::shortchunk& shortchunk) {
+  return [&sink, timeout](const felix::packetformat::shortchunk& shortchunk) {
     // Only dump to buffer if possible
     std::size_t target_size = sizeof(TargetStruct);
     if (shortchunk.length != target_size) {
       // report? Add custom way of handling unexpected user payloads.
       //  In this case -> not fixed size shortchunk -> shortchunk-to-userbuff not possible
       // Can't throw, and can't print as it may flood output
-    } else {
-      TargetStruct payload;
-      std::memcpy(static_cast<char*>(payload), shortchunk.data, target_size);
-      try {
-        // finally, push to sink
-        sink->send(std::move(payload), timeout);
-      } catch (const dunedaq::iomanager::TimeoutExpired& excpt) {
-        // ers::error(ParserOperationQueuePushFailure(ERS_HERE, " "));
-      }
+      return true;
     }
+    TargetStruct payload;
+    std::memcpy(static_cast<char*>(payload), shortchunk.data, target_size);
+    return sink->try_send(std::move(payload), timeout);
   };
 }
 
+// Large fixed size payloads handed downstream on the heap, as handles of an ObjectPool. Objects return to the
+// pool with their handle.
 template<class TargetStruct>
-inline std::function<void(const felix::packetformat::chunk& chunk)>
-fixsizedChunkViaHeap(std::shared_ptr<iomanager::SenderConcept<TargetStruct*>>& sink,
-                     // std::shared_ptr<iomanager::SenderConcept<std::unique_ptr<TargetStruct>>>& sink,
-                     std::chrono::milliseconds timeout = std::chrono::milliseconds(100))
+inline bool
+fixsized_chunk_via_heap(const felix::packetformat::chunk& chunk,
+                        std::shared_ptr<iomanager::SenderConcept<typename ObjectPool<TargetStruct>::Handle>>& sink,
+                        ObjectPool<TargetStruct>& payload_pool,
+                        std::chrono::milliseconds timeout,
+                        std::size_t streaming_threshold = 0)
 {
-  return [&](const felix::packetformat::chunk& chunk) {
-    // Chunk info
-    auto subchunk_data = chunk.subchunks();
-    auto subchunk_sizes = chunk.subchunk_lengths();
-    auto n_subchunks = chunk.subchunk_number();
-    auto target_size = sizeof(TargetStruct);
+  // Chunk info
+  auto subchunk_data = chunk.subchunks();
+  auto subchunk_sizes = chunk.subchunk_lengths();
+  auto n_subchunks = chunk.subchunk_number();
+  auto target_size = sizeof(TargetStruct);
 
-    // Only dump to buffer if possible
-    if (chunk.length() != target_size) {
-      // report? Add custom way of handling unexpected user payloads.
-      //   In this case -> not fixed size chunk -> chunk-to-userbuff not possible
-    } else {
-      TargetStruct* payload = new TargetStruct[sizeof(TargetStruct)];
-      // std::unique_ptr<TargetStruct> payload = std::make_unique<TargetStruct>();
-      uint_fast32_t bytes_copied_chunk = 0; // NOLINT
-      for (unsigned i = 0; i < n_subchunks; i++) {
-        dump_to_buffer(subchunk_data[i],
-                       subchunk_sizes[i],
-                       static_cast<void*>(payload), // static_cast<void*>(&payload_ptr->data),
-                       bytes_copied_chunk,
-                       target_size);
-        bytes_copied_chunk += subchunk_sizes[i];
-      }
-      try {
-        // finally, push to sink
-        sink->send(std::move(payload), timeout); // std::move(std::make_unique<TargetStruct>(payload)), timeout);
-      } catch (const dunedaq::iomanager::TimeoutExpired& excpt) {
-        // ers::error(ParserOperationQueuePushFailure(ERS_HERE, " "));
-      }
+  // Only dump to buffer if possible
+  if (chunk.length() != target_size) {
+    ers::error(UnexpectedChunk(ERS_HERE, chunk.length(), target_size));
+    return true;
+  }
+  auto payload = payload_pool.acquire();
+  copy_subchunks(
+    static_cast<void*>(payload.get()), target_size, subchunk_data, subchunk_sizes, n_subchunks, streaming_threshold);
+  return sink->try_send(std::move(payload), timeout);
+}
+
+// The pool of pool_capacity objects is created by the first chunk, on the parser thread.
+template<class TargetStruct>
+inline std::function<bool(const felix::packetformat::chunk& chunk)>
+fixsizedChunkViaHeap(std::shared_ptr<iomanager::SenderConcept<typename ObjectPool<TargetStruct>::Handle>>& sink,
+                     std::size_t pool_capacity = 1024,
+                     std::chrono::milliseconds timeout = std::chrono::milliseconds(100))
+{
+  return [&sink, pool_capacity, timeout, pool = std::shared_ptr<ObjectPool<TargetStruct>>()](
+           const felix::packetformat::chunk& chunk) mutable {
+    if (!pool) {
+      pool = ObjectPool<TargetStruct>::create(pool_capacity);
     }
+    return fixsized_chunk_via_heap(chunk, sink, *pool, timeout);
   };
 }
 
 template<class TargetWithDatafield>
-inline std::function<void(const felix::packetformat::chunk&)>
+inline std::function<bool(const felix::packetformat::chunk&)>
 varsizedChunkIntoWithDatafield(std::shared_ptr<iomanager::SenderConcept<TargetWithDatafield>>& sink,
                                std::chrono::milliseconds timeout = std::chrono::milliseconds(100))
 {
-  return [&](const felix::packetformat::chunk& chunk) {
+  return [&sink, timeout](const felix::packetformat::chunk& chunk) {
     auto subchunk_data = chunk.subchunks();
     auto subchunk_sizes = chunk.subchunk_lengths();
     auto n_subchunks = chunk.subchunk_number();
     TargetWithDatafield twd;
     twd.get_data().reserve(chunk.length());
-    uint32_t bytes_copied_chunk = 0;
-    for (unsigned i = 0; i< n_subchunks; ++i) {
-      dump_to_buffer(subchunk_data[i],
-                     subchunk_sizes[i],
-                     static_cast<void*>(twd.get_data().data()),
-                     bytes_copied_chunk,
-                     chunk.length());
-      bytes_copied_chunk += subchunk_sizes[i];
-    }
+    auto bytes_copied_chunk = copy_subchunks(
+      static_cast<void*>(twd.get_data().data()), chunk.length(), subchunk_data, subchunk_sizes, n_subchunks);
     twd.set_data_size(bytes_copied_chunk);
-    try {
-      sink->send(std::move(twd), timeout);
-    } catch (const dunedaq::iomanager::TimeoutExpired& excpt) {
-      // ers::error
-    }
+    return sink->try_send(std::move(twd), timeout);
   };
 }
 
 template<class TargetWithDatafield>
-inline std::function<void(const felix::packetformat::shortchunk&)>
+inline std::function<bool(const felix::packetformat::shortchunk&)>
 varsizedShortchunkIntoWithDatafield(std::shared_ptr<iomanager::SenderConcept<TargetWithDatafield>>& sink,
                                std::chrono::milliseconds timeout = std::chrono::milliseconds(100))
 {
-  return [&](const felix::packetformat::shortchunk& shortchunk) {
+  return [&sink, timeout](const felix::packetformat::shortchunk& shortchunk) {
     TargetWithDatafield twd;
     twd.get_data().reserve(shortchunk.length);
     std::memcpy(static_cast<void*>(twd.get_data().data()), shortchunk.data, shortchunk.length);
     twd.set_data_size(shortchunk.length);
-    try {
-      sink->send(std::move(twd), timeout);
-    } catch (const dunedaq::iomanager::TimeoutExpired& excpt) {
-      // ers::error
-    }
+    return sink->try_send(std::move(twd), timeout);
   };
 }
 
-inline std::function<void(const felix::packetformat::chunk& chunk)>
+inline bool
+varsized_chunk_into_wrapper(const felix::packetformat::chunk& chunk,
+                            std::shared_ptr<iomanager::SenderConcept<fdreadoutlibs::types::VariableSizePayloadTypeAdapter>>& sink,
+                            std::chrono::milliseconds timeout,
+                            std::size_t streaming_threshold = 0)
+{
+  auto subchunk_data = chunk.subchunks();
+  auto subchunk_sizes = chunk.subchunk_lengths();
+  auto n_subchunks = chunk.subchunk_number();
+  auto chunk_length = chunk.length();
+
+  char* payload = static_cast<char*>(malloc(chunk_length * sizeof(char)));
+  copy_subchunks(
+    static_cast<void*>(payload), chunk_length, subchunk_data, subchunk_sizes, n_subchunks, streaming_threshold);
+  fdreadoutlibs::types::VariableSizePayloadTypeAdapter payload_wrapper(chunk_length, payload);
+  return sink->try_send(std::move(payload_wrapper), timeout);
+}
+
+inline bool
+varsized_shortchunk_into_wrapper(const felix::packetformat::shortchunk& shortchunk,
+                                 std::shared_ptr<iomanager::SenderConcept<fdreadoutlibs::types::VariableSizePayloadTypeAdapter>>& sink,
+                                 std::chrono::milliseconds timeout)
+{
+  auto shortchunk_length = shortchunk.length;
+  char* payload = static_cast<char*>(malloc(shortchunk_length * sizeof(char)));
+  std::memcpy(payload, shortchunk.data, shortchunk_length);
+  fdreadoutlibs::types::VariableSizePayloadTypeAdapter payload_wrapper(shortchunk_length, payload);
+  return sink->try_send(std::move(payload_wrapper), timeout);
+}
+
+// Variable size chunks into a buffer of the payload pool of the elink, returned to it with the payload
+inline bool
+varsized_chunk_into_pool(const felix::packetformat::chunk& chunk,
+                         std::shared_ptr<iomanager::SenderConcept<types::VariableSizePooledPayload>>& sink,
+                         SlabPool& payload_pool,
+                         std::chrono::milliseconds timeout,
+                         std::size_t streaming_threshold = 0)
+{
+  auto subchunk_data = chunk.subchunks();
+  auto subchunk_sizes = chunk.subchunk_lengths();
+  auto n_subchunks = chunk.subchunk_number();
+  auto chunk_length = chunk.length();
+
+  auto payload = payload_pool.allocate(chunk_length);
+  copy_subchunks(
+    static_cast<void*>(payload.get()), chunk_length, subchunk_data, subchunk_sizes, n_subchunks, streaming_threshold);
+  return sink->try_send(types::VariableSizePooledPayload(chunk_length, std::move(payload)), timeout);
+}
+
+inline bool
+varsized_shortchunk_into_pool(const felix::packetformat::shortchunk& shortchunk,
+                              std::shared_ptr<iomanager::SenderConcept<types::VariableSizePooledPayload>>& sink,
+                              SlabPool& payload_pool,
+                              std::chrono::milliseconds timeout)
+{
+  auto shortchunk_length = shortchunk.length;
+  auto payload = payload_pool.allocate(shortchunk_length);
+  std::memcpy(payload.get(), shortchunk.data, shortchunk_length);
+  return sink->try_send(types::VariableSizePooledPayload(shortchunk_length, std::move(payload)), timeout);
+}
+
+inline std::function<bool(const felix::packetformat::chunk& chunk)>
 varsizedChunkIntoWrapper(std::shared_ptr<iomanager::SenderConcept<fdreadoutlibs::types::VariableSizePayloadTypeAdapter>>& sink,
                          std::chrono::milliseconds timeout = std::chrono::milliseconds(100))
 {
-  return [&](const felix::packetformat::chunk& chunk) {
-    auto subchunk_data = chunk.subchunks();
-    auto subchunk_sizes = chunk.subchunk_lengths();
-    auto n_subchunks = chunk.subchunk_number();
-    auto chunk_length = chunk.length();
-
-    char* payload = static_cast<char*>(malloc(chunk_length * sizeof(char)));
-    uint32_t bytes_copied_chunk = 0; // NOLINT(build/unsigned)
-    for (unsigned i = 0; i < n_subchunks; ++i) {
-      dump_to_buffer(
-        subchunk_data[i], subchunk_sizes[i], static_cast<void*>(payload), bytes_copied_chunk, chunk_length);
-      bytes_copied_chunk += subchunk_sizes[i];
-    }
-    fdreadoutlibs::types::VariableSizePayloadTypeAdapter payload_wrapper(chunk_length, payload);
-    try {
-      sink->send(std::move(payload_wrapper), timeout);
-    } catch (const dunedaq::iomanager::TimeoutExpired& excpt) {
-      // ers
-    }
+  return [&sink, timeout](const felix::packetformat::chunk& chunk) {
+    return varsized_chunk_into_wrapper(chunk, sink, timeout);
   };
 }
 
-inline std::function<void(const felix::packetformat::shortchunk& shortchunk)>
+inline std::function<bool(const felix::packetformat::shortchunk& shortchunk)>
 varsizedShortchunkIntoWrapper(std::shared_ptr<iomanager::SenderConcept<fdreadoutlibs::types::VariableSizePayloadTypeAdapter>>& sink,
                               std::chrono::milliseconds timeout = std::chrono::milliseconds(100))
 {
-  return [&](const felix::packetformat::shortchunk& shortchunk) {
-    auto shortchunk_length = shortchunk.length;
-    char* payload = static_cast<char*>(malloc(shortchunk_length * sizeof(char)));
-    std::memcpy(payload, shortchunk.data, shortchunk_length);
-    fdreadoutlibs::types::VariableSizePayloadTypeAdapter payload_wrapper(shortchunk_length, payload);
-    try {
-      sink->send(std::move(payload_wrapper), timeout);
-    } catch (const dunedaq::iomanager::TimeoutExpired& excpt) {
-      // ers
-    }
+  return [&sink, timeout](const felix::packetformat::shortchunk& shortchunk) {
+    return varsized_shortchunk_into_wrapper(shortchunk, sink, timeout);
   };
 }
 
 
-inline std::function<void(const felix::packetformat::chunk& chunk)>
+inline std::function<bool(const felix::packetformat::chunk& chunk)>
 errorChunkIntoSink(std::shared_ptr<iomanager::SenderConcept<felix::packetformat::chunk>>& sink,
                    std::chrono::milliseconds timeout = std::chrono::milliseconds(100))
 {
-  return [&](const felix::packetformat::chunk& chunk) {
-    try {
-      auto payload = chunk;
-      sink->send(std::move(payload), timeout);
-    } catch (const dunedaq::iomanager::TimeoutExpired& excpt) {
-      // ers
-    }
+  return [&sink, timeout](const felix::packetformat::chunk& chunk) {
+    auto payload = chunk;
+    return sink->try_send(std::move(payload), timeout);
   };
 }
 
 
+//// Sink policies of StaticParserImpl: the same operations as above, resolved at compile time
+
+// The reservable sink is the same sender as sink, if it implements ReservableSender, and nullptr otherwise.
+// The payload pool is the one of the elink, of type payload_pool_t<TargetStruct>: void for the policies without
+// one, which get nullptr. Policies with a pool create it with create_payload_pool<TargetStruct>(capacity,
+// max_payload_size). The operations return false if they dropped the payload on a full sink. Chunks are copied
+// with the streaming_threshold of copy_subchunks, shortchunks are small enough to always be copied through the
+// caches.
+
+// Fixed size chunks copied into TargetStruct, in place if the sink supports it. Shortchunks are ignored.
+struct FixsizedChunkPolicy
+{
+  template<class TargetStruct>
+  using payload_pool_t = void;
+
+  template<class TargetStruct, class Chunk>
+  static bool chunk(const Chunk& chunk,
+                    std::shared_ptr<iomanager::SenderConcept<TargetStruct>>& sink,
+                    ReservableSender<TargetStruct>* reservable_sink,
+                    void* /*payload_pool*/,
+                    std::chrono::milliseconds timeout,
+                    std::size_t streaming_threshold)
+  {
+    // The chunk is copied over the whole TargetStruct, from its data member
+    static_assert(sizeof(TargetStruct::data) == sizeof(TargetStruct),
+                  "FixsizedChunkPolicy needs a payload type made of its data array");
+    if (reservable_sink != nullptr) {
+      return fixsized_chunk_into_reserved(chunk, *reservable_sink, timeout, streaming_threshold);
+    }
+    return fixsized_chunk_into(chunk, sink, timeout, streaming_threshold);
+  }
+
+  template<class TargetStruct>
+  static bool shortchunk(const felix::packetformat::shortchunk& /*shortchunk*/,
+                         std::shared_ptr<iomanager::SenderConcept<TargetStruct>>& /*sink*/,
+                         ReservableSender<TargetStruct>* /*reservable_sink*/,
+                         void* /*payload_pool*/,
+                         std::chrono::milliseconds /*timeout*/)
+  {
+    return true;
+  }
+};
+
+// Fixed size chunks copied into objects of an ObjectPool per elink, sent as their ObjectPool<T>::Handle, for
+// payloads too large to be moved through the sink by value. Shortchunks are ignored.
+struct FixsizedHeapPolicy
+{
+  template<class Handle>
+  using payload_pool_t = ObjectPool<typename Handle::element_type>;
+
+  template<class Handle>
+  static std::shared_ptr<payload_pool_t<Handle>> create_payload_pool(std::size_t capacity,
+                                                                     std::size_t /*max_payload_size*/)
+  {
+    return payload_pool_t<Handle>::create(capacity);
+  }
+
+  template<class Handle>
+  static bool chunk(const felix::packetformat::chunk& chunk,
+                    std::shared_ptr<iomanager::SenderConcept<Handle>>& sink,
+                    ReservableSender<Handle>* /*reservable_sink*/,
+                    payload_pool_t<Handle>* payload_pool,
+                    std::chrono::milliseconds timeout,
+                    std::size_t streaming_threshold)
+  {
+    using TargetStruct = typename Handle::element_type;
+    static_assert(sizeof(TargetStruct::data) == sizeof(TargetStruct),
+                  "FixsizedHeapPolicy needs a payload type made of its data array");
+    return fixsized_chunk_via_heap(chunk, sink, *payload_pool, timeout, streaming_threshold);
+  }
+
+  template<class Handle>
+  static bool shortchunk(const felix::packetformat::shortchunk& /*shortchunk*/,
+                         std::shared_ptr<iomanager::SenderConcept<Handle>>& /*sink*/,
+                         ReservableSender<Handle>* /*reservable_sink*/,
+                         payload_pool_t<Handle>* /*payload_pool*/,
+                         std::chrono::milliseconds /*timeout*/)
+  {
+    return true;
+  }
+};
+
+// Chunks and shortchunks of any size, wrapped into VariableSizePayloadTypeAdapter. Its consumers free() the
+// buffers, so they are malloc-ed: see VarsizedPooledPolicy for payloads from a pool.
+struct VarsizedWrapperPolicy
+{
+  using payload_t = fdreadoutlibs::types::VariableSizePayloadTypeAdapter;
+  using sink_ptr_t = std::shared_ptr<iomanager::SenderConcept<payload_t>>;
+  template<class TargetStruct>
+  using payload_pool_t = void;
+
+  static bool chunk(const felix::packetformat::chunk& chunk,
+                    sink_ptr_t& sink,
+                    ReservableSender<payload_t>* /*reservable_sink*/,
+                    void* /*payload_pool*/,
+                    std::chrono::milliseconds timeout,
+                    std::size_t streaming_threshold)
+  {
+    return varsized_chunk_into_wrapper(chunk, sink, timeout, streaming_threshold);
+  }
+
+  static bool shortchunk(const felix::packetformat::shortchunk& shortchunk,
+                         sink_ptr_t& sink,
+                         ReservableSender<payload_t>* /*reservable_sink*/,
+                         void* /*payload_pool*/,
+                         std::chrono::milliseconds timeout)
+  {
+    return varsized_shortchunk_into_wrapper(shortchunk, sink, timeout);
+  }
+};
+
+// Chunks and shortchunks of any size, in VariableSizePooledPayload buffers of a SlabPool per elink.
+struct VarsizedPooledPolicy
+{
+  using payload_t = types::VariableSizePooledPayload;
+  using sink_ptr_t = std::shared_ptr<iomanager::SenderConcept<payload_t>>;
+  template<class TargetStruct>
+  using payload_pool_t = SlabPool;
+
+  template<class TargetStruct>
+  static std::shared_ptr<SlabPool> create_payload_pool(std::size_t capacity, std::size_t max_payload_size)
+  {
+    return SlabPool::create(capacity, max_payload_size);
+  }
+
+  static bool chunk(const felix::packetformat::chunk& chunk,
+                    sink_ptr_t& sink,
+                    ReservableSender<payload_t>* /*reservable_sink*/,
+                    SlabPool* payload_pool,
+                    std::chrono::milliseconds timeout,
+                    std::size_t streaming_threshold)
+  {
+    return varsized_chunk_into_pool(chunk, sink, *payload_pool, timeout, streaming_threshold);
+  }
+
+  static bool shortchunk(const felix::packetformat::shortchunk& shortchunk,
+                         sink_ptr_t& sink,
+                         ReservableSender<payload_t>* /*reservable_sink*/,
+                         SlabPool* payload_pool,
+                         std::chrono::milliseconds timeout)
+  {
+    return varsized_shortchunk_into_pool(shortchunk, sink, *payload_pool, timeout);
+  }
+};
+
 //// Implement here any other DUNE specific FELIX chunk/block to User payload parsers
 
 } // namespace parsers
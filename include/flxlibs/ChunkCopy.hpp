@@ -0,0 +1,134 @@
+/**
+ * @file ChunkCopy.hpp Copy kernels assembling FELIX chunks, i.e.: their
+ * subchunks, into user payloads. Free of DAQ dependencies, so they can be
+ * benchmarked on their own.
+ *
+ * This is part of the DUNE DAQ , copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef FLXLIBS_INCLUDE_FLXLIBS_CHUNKCOPY_HPP_
+#define FLXLIBS_INCLUDE_FLXLIBS_CHUNKCOPY_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace dunedaq {
+namespace flxlibs {
+namespace parsers {
+
+// Copies size bytes into a circular buffer of buffer_size bytes, from buffer_pos.
+inline void
+dump_to_buffer(const char* data,
+               std::size_t size,
+               void* buffer,
+               uint32_t buffer_pos, // NOLINT
+               const std::size_t& buffer_size)
+{
+  auto bytes_to_copy = size; // NOLINT
+  while (bytes_to_copy > 0) {
+    auto n = std::min(bytes_to_copy, buffer_size - buffer_pos); // NOLINT
+    std::memcpy(static_cast<char*>(buffer) + buffer_pos, data, n);
+    buffer_pos += n;
+    bytes_to_copy -= n;
+    if (buffer_pos == buffer_size) {
+      buffer_pos = 0;
+    }
+  }
+}
+
+// Copy with non-temporal stores: the destination doesn't evict the working set of the parser from the caches.
+// Needs a store fence (see copy_subchunks) before the destination is handed to another thread.
+inline void
+stream_copy(char* dest, const char* src, std::size_t size)
+{
+#if defined(__SSE2__)
+  // Unaligned head
+  std::size_t head = std::min<std::size_t>((16 - (reinterpret_cast<uintptr_t>(dest) & 15)) & 15, size); // NOLINT
+  std::memcpy(dest, src, head);
+  dest += head;
+  src += head;
+  size -= head;
+  for (; size >= 64; size -= 64, src += 64, dest += 64) {
+    auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));      // NOLINT
+    auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16)); // NOLINT
+    auto c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32)); // NOLINT
+    auto d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 48)); // NOLINT
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dest), a);                // NOLINT
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dest + 16), b);           // NOLINT
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dest + 32), c);           // NOLINT
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dest + 48), d);           // NOLINT
+  }
+  for (; size >= 16; size -= 16, src += 16, dest += 16) {
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dest), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src))); // NOLINT
+  }
+  // Tail
+  std::memcpy(dest, src, size);
+#else
+  std::memcpy(dest, src, size);
+#endif
+}
+
+/**
+ * @brief Copies the subchunks of a chunk into buffer. Runs of subchunks that are contiguous in memory, and the
+ * common single subchunk case, are copied in one go. Chunks larger than the buffer wrap around, as with
+ * dump_to_buffer. Chunks of at least streaming_threshold bytes are copied with non-temporal stores, 0 disables
+ * streaming. Returns the number of bytes copied.
+ */
+template<class SubchunkData, class SubchunkSizes>
+inline std::size_t
+copy_subchunks(void* buffer,
+               std::size_t buffer_size,
+               const SubchunkData& subchunk_data,
+               const SubchunkSizes& subchunk_sizes,
+               unsigned n_subchunks,
+               std::size_t streaming_threshold = 0)
+{
+  std::size_t total_size = 0;
+  for (unsigned i = 0; i < n_subchunks; ++i) {
+    total_size += subchunk_sizes[i];
+  }
+  if (total_size > buffer_size) {
+    uint32_t bytes_copied = 0; // NOLINT(build/unsigned)
+    for (unsigned i = 0; i < n_subchunks; ++i) {
+      dump_to_buffer(subchunk_data[i], subchunk_sizes[i], buffer, bytes_copied % buffer_size, buffer_size);
+      bytes_copied += subchunk_sizes[i];
+    }
+    return total_size;
+  }
+
+  char* dest = static_cast<char*>(buffer);
+  bool streaming = streaming_threshold != 0 && total_size >= streaming_threshold;
+  unsigned i = 0;
+  while (i < n_subchunks) {
+    const char* run = subchunk_data[i];
+    std::size_t run_size = subchunk_sizes[i];
+    for (++i; i < n_subchunks && run + run_size == subchunk_data[i]; ++i) {
+      run_size += subchunk_sizes[i];
+    }
+    if (streaming) {
+      stream_copy(dest, run, run_size);
+    } else {
+      std::memcpy(dest, run, run_size);
+    }
+    dest += run_size;
+  }
+#if defined(__SSE2__)
+  if (streaming) {
+    _mm_sfence();
+  }
+#endif
+  return total_size;
+}
+
+} // namespace parsers
+} // namespace flxlibs
+} // namespace dunedaq
+
+#endif // FLXLIBS_INCLUDE_FLXLIBS_CHUNKCOPY_HPP_
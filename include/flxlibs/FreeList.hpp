@@ -0,0 +1,81 @@
+/**
+ * @file FreeList.hpp Lock-free free list of the slots of a pool, shared by the
+ * payload pools of the parsers.
+ *
+ * This is part of the DUNE DAQ , copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef FLXLIBS_INCLUDE_FLXLIBS_FREELIST_HPP_
+#define FLXLIBS_INCLUDE_FLXLIBS_FREELIST_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace dunedaq {
+namespace flxlibs {
+
+// Counters of a payload pool since its last get_stats
+struct PoolStats
+{
+  uint64_t hits;      // NOLINT(build/unsigned) allocated from the pool
+  uint64_t misses;    // NOLINT(build/unsigned) too large for the pool, allocated on the heap
+  uint64_t exhausted; // NOLINT(build/unsigned) finding the pool empty, allocated on the heap
+};
+
+/**
+ * @brief A stack of slot indices linked through an array, with an ABA tag in the upper half of its head.
+ * Any thread pushes and pops. Initially holds all the slots.
+ */
+class FreeList
+{
+public:
+  explicit FreeList(std::size_t capacity)
+    : m_next(std::make_unique<std::atomic<uint32_t>[]>(capacity)) // NOLINT(build/unsigned)
+  {
+    for (std::size_t slot = 0; slot < capacity; ++slot) {
+      m_next[slot].store(slot + 1 < capacity ? slot + 1 : s_empty, std::memory_order_relaxed);
+    }
+    m_head.store(capacity > 0 ? 0 : s_empty, std::memory_order_relaxed);
+  }
+
+  // Takes a free slot, false if there is none
+  bool pop(uint32_t& slot) // NOLINT(build/unsigned)
+  {
+    auto head = m_head.load(std::memory_order_acquire);
+    do {
+      slot = static_cast<uint32_t>(head); // NOLINT(build/unsigned)
+      if (slot == s_empty) {
+        return false;
+      }
+    } while (!m_head.compare_exchange_weak(
+      head, next_head(head, m_next[slot].load(std::memory_order_relaxed)), std::memory_order_acquire));
+    return true;
+  }
+
+  void push(uint32_t slot) // NOLINT(build/unsigned)
+  {
+    auto head = m_head.load(std::memory_order_relaxed);
+    do {
+      m_next[slot].store(static_cast<uint32_t>(head), std::memory_order_relaxed); // NOLINT(build/unsigned)
+    } while (!m_head.compare_exchange_weak(head, next_head(head, slot), std::memory_order_release));
+  }
+
+private:
+  static constexpr uint32_t s_empty = UINT32_MAX; // NOLINT(build/unsigned)
+
+  static uint64_t next_head(uint64_t head, uint32_t slot) // NOLINT(build/unsigned)
+  {
+    return ((head >> 32) + 1) << 32 | slot;
+  }
+
+  std::unique_ptr<std::atomic<uint32_t>[]> m_next; // NOLINT(build/unsigned)
+  alignas(64) std::atomic<uint64_t> m_head;        // NOLINT(build/unsigned)
+};
+
+} // namespace flxlibs
+} // namespace dunedaq
+
+#endif // FLXLIBS_INCLUDE_FLXLIBS_FREELIST_HPP_
@@ -0,0 +1,107 @@
+/**
+ * @file ObjectPool.hpp Pool of recycled payload objects, handed downstream as
+ * unique handles that return their object to the pool when destroyed.
+ *
+ * This is part of the DUNE DAQ , copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef FLXLIBS_INCLUDE_FLXLIBS_OBJECTPOOL_HPP_
+#define FLXLIBS_INCLUDE_FLXLIBS_OBJECTPOOL_HPP_
+
+#include "flxlibs/FreeList.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace dunedaq {
+namespace flxlibs {
+
+/**
+ * @brief capacity objects of T, default-initialized at creation: the pages of trivial types are first touched by
+ * the thread filling the objects, on its NUMA node. When the pool is exhausted, objects are allocated on the heap,
+ * counted, and deleted by their handle. The pool stays alive until the owner dropped it and the last of its
+ * handles got destroyed.
+ */
+template<class T>
+class ObjectPool
+{
+public:
+  // Deleter of the handles: returns the object to its pool, or deletes it if it doesn't come from one
+  struct Recycle
+  {
+    ObjectPool* pool{ nullptr };
+    void operator()(T* object) const
+    {
+      if (pool != nullptr) {
+        pool->recycle(object);
+      } else {
+        delete object; // NOLINT
+      }
+    }
+  };
+  using Handle = std::unique_ptr<T, Recycle>;
+  using Stats = PoolStats;
+
+  static std::shared_ptr<ObjectPool> create(std::size_t capacity)
+  {
+    return std::shared_ptr<ObjectPool>(new ObjectPool(capacity), [](ObjectPool* pool) { pool->drop_ref(); });
+  }
+
+  ObjectPool(const ObjectPool&) = delete;            ///< ObjectPool is not copy-constructible
+  ObjectPool& operator=(const ObjectPool&) = delete; ///< ObjectPool is not copy-assignable
+  ObjectPool(ObjectPool&&) = delete;                 ///< ObjectPool is not move-constructible
+  ObjectPool& operator=(ObjectPool&&) = delete;      ///< ObjectPool is not move-assignable
+
+  Handle acquire()
+  {
+    uint32_t slot; // NOLINT(build/unsigned)
+    if (!m_free_slots.pop(slot)) {
+      m_exhausted.fetch_add(1, std::memory_order_relaxed);
+      return Handle(new T(), Recycle{}); // NOLINT
+    }
+    m_refs.fetch_add(1, std::memory_order_relaxed);
+    m_hits.fetch_add(1, std::memory_order_relaxed);
+    return Handle(&m_objects[slot], Recycle{ this });
+  }
+
+  // Counters since the last call. No misses: all the objects have the same size.
+  Stats get_stats()
+  {
+    return { m_hits.exchange(0, std::memory_order_relaxed), 0, m_exhausted.exchange(0, std::memory_order_relaxed) };
+  }
+
+private:
+  explicit ObjectPool(std::size_t capacity)
+    : m_objects(new T[capacity]) // NOLINT
+    , m_free_slots(capacity)
+  {}
+
+  ~ObjectPool() = default;
+
+  void recycle(T* object)
+  {
+    m_free_slots.push(static_cast<uint32_t>(object - m_objects.get())); // NOLINT(build/unsigned)
+    drop_ref();
+  }
+
+  void drop_ref()
+  {
+    if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  std::unique_ptr<T[]> m_objects;
+  FreeList m_free_slots;
+  std::atomic<std::size_t> m_refs{ 1 }; // the owner, and every pooled handle out
+  std::atomic<uint64_t> m_hits{ 0 };      // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_exhausted{ 0 }; // NOLINT(build/unsigned)
+};
+
+} // namespace flxlibs
+} // namespace dunedaq
+
+#endif // FLXLIBS_INCLUDE_FLXLIBS_OBJECTPOOL_HPP_
@@ -0,0 +1,38 @@
+/**
+ * @file ReservableSender.hpp Reserve/commit extension of a sender, for sinks
+ * that can hand out the storage of their next element, e.g.: the slot of a
+ * ring buffer. Parsers then assemble payloads in place, instead of building
+ * them on the stack and moving them into send.
+ *
+ * This is part of the DUNE DAQ , copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef FLXLIBS_INCLUDE_FLXLIBS_RESERVABLESENDER_HPP_
+#define FLXLIBS_INCLUDE_FLXLIBS_RESERVABLESENDER_HPP_
+
+#include <chrono>
+
+namespace dunedaq {
+namespace flxlibs {
+
+/**
+ * @brief Implemented next to iomanager::SenderConcept<T> by the senders that support it. A single producer
+ * reserves an element, fills it, and commits it before reserving the next one.
+ */
+template<class T>
+class ReservableSender
+{
+public:
+  virtual ~ReservableSender() = default;
+
+  // Storage of the next element, nullptr if none got free within the timeout
+  virtual T* reserve(std::chrono::milliseconds timeout) = 0;
+  // Publishes the element returned by the last reserve
+  virtual void commit() = 0;
+};
+
+} // namespace flxlibs
+} // namespace dunedaq
+
+#endif // FLXLIBS_INCLUDE_FLXLIBS_RESERVABLESENDER_HPP_
@@ -0,0 +1,182 @@
+/**
+ * @file SlabPool.hpp Size-class slab pool for variable size payloads. The
+ * parser of an elink allocates from it, and the consumer of the payloads
+ * returns them from any thread by destroying their SlabPool::Buffer.
+ *
+ * This is part of the DUNE DAQ , copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef FLXLIBS_INCLUDE_FLXLIBS_SLABPOOL_HPP_
+#define FLXLIBS_INCLUDE_FLXLIBS_SLABPOOL_HPP_
+
+#include "flxlibs/FreeList.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace dunedaq {
+namespace flxlibs {
+
+/**
+ * @brief Buffers come in power of two size classes, from 64 bytes up to the configured maximum payload size,
+ * with capacity buffers per class carved out of one slab. Each buffer is preceded by a header naming its pool
+ * and slot, so release needs nothing but the payload pointer. Payloads larger than the largest class (misses)
+ * and payloads finding their class empty (exhaustion) are malloc-ed with the same header, and freed on release.
+ *
+ * A single thread allocates, any thread releases. The pool stays alive until the owner dropped it and the last
+ * of its buffers got released, so payloads may outlive the elink.
+ */
+class SlabPool
+{
+public:
+  using Stats = PoolStats;
+
+  // Deleter of the buffers: returns them to their pool, or frees them
+  struct Release
+  {
+    void operator()(char* data) const { SlabPool::release(data); }
+  };
+  using Buffer = std::unique_ptr<char[], Release>;
+
+  static std::shared_ptr<SlabPool> create(std::size_t capacity, std::size_t max_payload_size)
+  {
+    return std::shared_ptr<SlabPool>(new SlabPool(capacity, max_payload_size),
+                                     [](SlabPool* pool) { pool->drop_ref(); });
+  }
+
+  SlabPool(const SlabPool&) = delete;            ///< SlabPool is not copy-constructible
+  SlabPool& operator=(const SlabPool&) = delete; ///< SlabPool is not copy-assignable
+  SlabPool(SlabPool&&) = delete;                 ///< SlabPool is not move-constructible
+  SlabPool& operator=(SlabPool&&) = delete;      ///< SlabPool is not move-assignable
+
+  // Returns a buffer of at least size bytes, empty only if malloc fails.
+  Buffer allocate(std::size_t size)
+  {
+    auto cls = size_class(size);
+    if (cls >= m_classes.size()) {
+      m_misses.fetch_add(1, std::memory_order_relaxed);
+      return Buffer(allocate_unpooled(size));
+    }
+    auto& sc = *m_classes[cls];
+    uint32_t slot; // NOLINT(build/unsigned)
+    if (!sc.free_slots.pop(slot)) {
+      m_exhausted.fetch_add(1, std::memory_order_relaxed);
+      return Buffer(allocate_unpooled(size));
+    }
+    m_refs.fetch_add(1, std::memory_order_relaxed);
+    m_hits.fetch_add(1, std::memory_order_relaxed);
+    return Buffer(sc.slab.get() + slot * sc.stride + s_header_size);
+  }
+
+  // Returns a buffer of allocate to its pool, or frees it. Lock-free, from any thread.
+  static void release(char* data)
+  {
+    if (data == nullptr) {
+      return;
+    }
+    auto* header = reinterpret_cast<Header*>(data - s_header_size); // NOLINT
+    if (header->pool == nullptr) {
+      std::free(header); // NOLINT
+    } else {
+      header->pool->recycle(header->size_class, header->slot);
+    }
+  }
+
+  // Counters since the last call
+  Stats get_stats()
+  {
+    return { m_hits.exchange(0, std::memory_order_relaxed),
+             m_misses.exchange(0, std::memory_order_relaxed),
+             m_exhausted.exchange(0, std::memory_order_relaxed) };
+  }
+
+private:
+  struct Header
+  {
+    SlabPool* pool;
+    uint32_t size_class; // NOLINT(build/unsigned)
+    uint32_t slot;       // NOLINT(build/unsigned)
+  };
+
+  struct SizeClass
+  {
+    SizeClass(std::size_t cls, std::size_t capacity)
+      : stride((std::size_t(1) << (cls + s_min_class_shift)) + s_header_size)
+      , slab(std::make_unique<char[]>(capacity * stride))
+      , free_slots(capacity)
+    {}
+
+    std::size_t stride;
+    std::unique_ptr<char[]> slab;
+    FreeList free_slots;
+  };
+
+  static constexpr std::size_t s_header_size = 16; // keeps the payloads 16 bytes aligned
+  static constexpr std::size_t s_min_class_shift = 6;
+  static_assert(sizeof(Header) <= s_header_size);
+
+  SlabPool(std::size_t capacity, std::size_t max_payload_size)
+  {
+    auto num_classes = capacity == 0 ? 0 : size_class(max_payload_size) + 1;
+    m_classes.reserve(num_classes);
+    for (std::size_t cls = 0; cls < num_classes; ++cls) {
+      auto& sc = m_classes.emplace_back(std::make_unique<SizeClass>(cls, capacity));
+      for (std::size_t slot = 0; slot < capacity; ++slot) {
+        auto* header = reinterpret_cast<Header*>(sc->slab.get() + slot * sc->stride); // NOLINT
+        header->pool = this;
+        header->size_class = cls;
+        header->slot = slot;
+      }
+    }
+  }
+
+  ~SlabPool() = default;
+
+  static std::size_t size_class(std::size_t size)
+  {
+    std::size_t cls = 0;
+    while ((std::size_t(1) << (cls + s_min_class_shift)) < size) {
+      ++cls;
+    }
+    return cls;
+  }
+
+  static char* allocate_unpooled(std::size_t size)
+  {
+    auto* header = static_cast<Header*>(std::malloc(s_header_size + size)); // NOLINT
+    if (header == nullptr) {
+      return nullptr;
+    }
+    header->pool = nullptr;
+    return reinterpret_cast<char*>(header) + s_header_size; // NOLINT
+  }
+
+  void recycle(uint32_t cls, uint32_t slot) // NOLINT(build/unsigned)
+  {
+    m_classes[cls]->free_slots.push(slot);
+    drop_ref();
+  }
+
+  void drop_ref()
+  {
+    if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  std::vector<std::unique_ptr<SizeClass>> m_classes;
+  std::atomic<std::size_t> m_refs{ 1 }; // the owner, and every pooled buffer out
+  std::atomic<uint64_t> m_hits{ 0 };      // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_misses{ 0 };    // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_exhausted{ 0 }; // NOLINT(build/unsigned)
+};
+
+} // namespace flxlibs
+} // namespace dunedaq
+
+#endif // FLXLIBS_INCLUDE_FLXLIBS_SLABPOOL_HPP_
@@ -0,0 +1,47 @@
+/**
+ * @file VariableSizePooledPayload.hpp Variable size payload in a buffer of
+ * the SlabPool of its elink.
+ *
+ * This is part of the DUNE DAQ , copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef FLXLIBS_INCLUDE_FLXLIBS_VARIABLESIZEPOOLEDPAYLOAD_HPP_
+#define FLXLIBS_INCLUDE_FLXLIBS_VARIABLESIZEPOOLEDPAYLOAD_HPP_
+
+#include "flxlibs/SlabPool.hpp"
+
+#include <cstddef>
+#include <utility>
+
+namespace dunedaq {
+namespace flxlibs {
+namespace types {
+
+/**
+ * @brief A chunk of any size, like fdreadoutlibs' VariableSizePayloadTypeAdapter, but its buffer goes back to the
+ * pool of the elink when the payload is destroyed, on any thread. Move-only. Consumers keep the buffer as long as
+ * they keep the payload, also after the elink is gone.
+ */
+struct VariableSizePooledPayload
+{
+  VariableSizePooledPayload() = default;
+  VariableSizePooledPayload(std::size_t payload_size, SlabPool::Buffer payload_data)
+    : size(payload_size)
+    , data(std::move(payload_data))
+  {}
+
+  char* begin() { return data.get(); }
+  char* end() { return data.get() + size; }
+  const char* begin() const { return data.get(); }
+  const char* end() const { return data.get() + size; }
+
+  std::size_t size{ 0 };
+  SlabPool::Buffer data;
+};
+
+} // namespace types
+} // namespace flxlibs
+} // namespace dunedaq
+
+#endif // FLXLIBS_INCLUDE_FLXLIBS_VARIABLESIZEPOOLEDPAYLOAD_HPP_
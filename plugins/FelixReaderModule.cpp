@@ -5,6 +5,8 @@
  * Licensing/copyright details are in the COPYING file that you should have
  * received with this code.
  */
+#include "flxlibs/felixcardreader/Nljs.hpp"
+
 #include "confmodel/ResourceSetAND.hpp"
 #include "confmodel/Connection.hpp"
 #include "confmodel/QueueWithSourceId.hpp"
@@ -17,15 +19,24 @@
 #include "appmodel/FelixDataSender.hpp"
 
 #include "CreateElink.hpp"
+#include "EmulatedDMASource.hpp"
 #include "FelixReaderModule.hpp"
 #include "FelixIssues.hpp"
+#include "Prefetch.hpp"
+
+#include "flxlibs/ChunkCopy.hpp"
+#include "flxlibs/opmon/FelixReaderModule.pb.h"
 
 #include "logging/Logging.hpp"
 
 #include "flxcard/FlxException.h"
 
+#include <algorithm>
 #include <chrono>
+#include <ctime>
+#include <iomanip>
 #include <memory>
+#include <sstream>
 #include <string>
 #include <thread>
 #include <utility>
@@ -54,10 +65,11 @@ FelixReaderModule::FelixReaderModule(const std::string& name)
   , m_configured(false)
   , m_card_id(0)
   , m_logical_unit(0)
+  , m_numa_id(0)
   , m_links_enabled()
   , m_num_links(0)
   , m_block_size(0)
-  , m_block_router(nullptr)
+  , m_block_batch_router(nullptr)
 //, block_ptr_sinks_{ }
 
 {
@@ -126,14 +138,17 @@ FelixReaderModule::init(const std::shared_ptr<appfwk::ConfigurationManager> mcfg
   }
   m_num_links = m_links_enabled.size();
   if (flx_if != nullptr) {
-        m_card_wrapper = std::make_unique<CardWrapper>(flx_if, m_links_enabled);
+        m_card_wrapper = std::make_shared<CardWrapper>(flx_if, m_links_enabled);
+        register_node("card-wrapper", m_card_wrapper);
         m_card_id = flx_if->get_card();
         m_logical_unit = flx_if->get_slr();
+        m_numa_id = flx_if->get_numa_id();
         m_block_size = flx_if->get_dma_block_size() * m_1kb_block_size;
         m_chunk_trailer_size = flx_if->get_chunk_trailer_size();
   }
   
 
+  TLOG() << get_name() << " can create ElinkModels for the data types: " << ElinkModelRegistry::get().get_data_types();
   for (auto qi : modconf->get_outputs()) {
     auto q_with_id = qi->cast<confmodel::QueueWithSourceId>();
     if (q_with_id == nullptr) continue;
@@ -149,40 +164,85 @@ FelixReaderModule::init(const std::shared_ptr<appfwk::ConfigurationManager> mcfg
     //m_elinks[q_with_id->get_source_id()]->init(args, m_block_queue_capacity);
   }
 
-  // Router function of block to appropriate ElinkHandlers
-  m_block_router = [&](uint64_t block_addr) { // NOLINT
-    // block_counter++;
-    const auto* block = const_cast<felix::packetformat::block*>(
-      felix::packetformat::block_from_bytes(reinterpret_cast<const char*>(block_addr)) // NOLINT
-    );
-    auto elink = block->elink;
-    if (m_elinks.count(elink) != 0) {
-      m_elinks[elink]->queue_in_block_address(block_addr);
-    } else {
-      // Really bad -> unexpeced ELINK ID in Block.
-      // This check is needed in order to avoid dynamically add thousands
-      // of ELink parser implementations on the fly, in case the data
-      // corruption is extremely severe.
-      //
-      // Possible causes:
-      //   -> enabled links that don't connect to anything
-      //   -> unexpected format (fw/sw version missmatch)
-      //   -> data corruption from FE
-      //   -> data corruption from CR (really rare, last possible cause)
-
-      // NO TLOG_DEBUG, but should count and periodically report corrupted DMA blocks.
+  // Router function of block to appropriate ElinkHandlers: demultiplex a whole DMA window in one loop.
+  // Optionally, keep m_prefetch_blocks block headers in flight ahead of the one being routed.
+  m_block_batch_router = [&](uint64_t first_block_addr, std::size_t num_blocks, uint64_t window_ns, std::size_t dma_index) { // NOLINT
+    constexpr std::size_t block_stride = CardWrapper::get_block_size();
+    if (m_block_recorder) {
+      m_block_recorder->record(dma_index, first_block_addr, num_blocks, block_stride);
+      if (m_record_only) {
+        // The recorder copied the blocks: they are done with
+        if (m_release_tracking) {
+          for (std::size_t i = 0; i < num_blocks; ++i) {
+            m_card_wrapper->release_block(first_block_addr + i * block_stride);
+          }
+        }
+        return;
+      }
+    }
+    const std::size_t prefetch_blocks = m_prefetch_blocks;
+    if (prefetch_blocks == 0) {
+      for (std::size_t i = 0; i < num_blocks; ++i) {
+        route_block(first_block_addr + i * block_stride, window_ns);
+      }
+      return;
+    }
+    for (std::size_t i = 0; i < std::min(prefetch_blocks, num_blocks); ++i) {
+      prefetch_block_header(first_block_addr + i * block_stride);
+    }
+    for (std::size_t i = 0; i < num_blocks; ++i) {
+      if (i + prefetch_blocks < num_blocks) {
+        prefetch_block_header(first_block_addr + (i + prefetch_blocks) * block_stride);
+      }
+      route_block(first_block_addr + i * block_stride, window_ns);
     }
   };
 
   // Set function for the CardWrapper's block processor.
-  m_card_wrapper->set_block_addr_handler(m_block_router);
+  m_card_wrapper->set_block_batch_handler(m_block_batch_router);
+}
+
+inline void
+FelixReaderModule::route_block(uint64_t block_addr, uint64_t window_ns) // NOLINT
+{
+  // block_counter++;
+  const auto* block = const_cast<felix::packetformat::block*>(
+    felix::packetformat::block_from_bytes(reinterpret_cast<const char*>(block_addr)) // NOLINT
+  );
+  // Called by the processors of every DMA descriptor: the dispatch table is read only while running.
+  auto* elink = m_elink_dispatch[block->elink];
+  if (elink != nullptr) {
+    if (!elink->queue_in_block_address(block_addr, window_ns) && m_release_tracking) {
+      m_card_wrapper->release_block(block_addr);
+    }
+  } else {
+    m_unknown_elink_ctr[block->elink].fetch_add(1, std::memory_order_relaxed);
+    m_unknown_elink_touched[block->elink / 64].fetch_or(uint64_t(1) << (block->elink % 64), // NOLINT(build/unsigned)
+                                                        std::memory_order_release);
+    if (m_release_tracking) {
+      m_card_wrapper->release_block(block_addr);
+    }
+    // Really bad -> unexpeced ELINK ID in Block.
+    // This check is needed in order to avoid dynamically add thousands
+    // of ELink parser implementations on the fly, in case the data
+    // corruption is extremely severe.
+    //
+    // Possible causes:
+    //   -> enabled links that don't connect to anything
+    //   -> unexpected format (fw/sw version missmatch)
+    //   -> data corruption from FE
+    //   -> data corruption from CR (really rare, last possible cause)
+
+    // NO TLOG_DEBUG: counted above, and reported by generate_opmon_data.
+  }
 }
 
 void
-FelixReaderModule::do_configure(const data_t& /*args*/)
+FelixReaderModule::do_configure(const data_t& args)
 {
    
     bool is_32b_trailer = false;
+    auto tuning = args.get<felixcardreader::Tuning>();
 
     TLOG(TLVL_BOOKKEEPING) << "Number of felix links specified in configuration: " << m_links_enabled.size();
     TLOG(TLVL_BOOKKEEPING) << "Number of data link handlers: " << m_elinks.size();
@@ -203,6 +263,70 @@ FelixReaderModule::do_configure(const data_t& /*args*/)
     TLOG(TLVL_WORK_STEPS) << "Card ID: " << m_card_id;
     TLOG(TLVL_WORK_STEPS) << "Configuring components with Block size:" << m_block_size
                           << " & trailer size: " << m_chunk_trailer_size;
+    m_card_wrapper->set_dma_cpu_affinity(tuning.dma_cpus);
+    if (!tuning.dma_ids.empty()) {
+      for (auto id : tuning.dma_ids) {
+        if (id > UINT8_MAX) {
+          throw ConfigurationError(ERS_HERE, "DMA descriptor " + std::to_string(id) + " is out of range");
+        }
+      }
+      for (auto id : tuning.dma_numa_ids) {
+        if (id > UINT8_MAX) {
+          throw ConfigurationError(ERS_HERE, "NUMA node " + std::to_string(id) + " is out of range");
+        }
+      }
+      std::vector<uint8_t> dma_ids(tuning.dma_ids.begin(), tuning.dma_ids.end());    // NOLINT(build/unsigned)
+      std::vector<uint8_t> numa_ids(tuning.dma_numa_ids.begin(), tuning.dma_numa_ids.end()); // NOLINT(build/unsigned)
+      m_card_wrapper->set_dma_ids(dma_ids, numa_ids);
+    }
+    m_release_tracking = tuning.release_tracking;
+    m_prefetch_blocks = tuning.prefetch_blocks;
+    OverflowPolicy overflow_policy = OverflowPolicy::kDrop;
+    if (tuning.overflow_policy == felixcardreader::OverflowPolicy::spin) {
+      overflow_policy = OverflowPolicy::kSpinRetry;
+    } else if (tuning.overflow_policy == felixcardreader::OverflowPolicy::stall) {
+      overflow_policy = OverflowPolicy::kStall;
+    }
+    if (tuning.emulated_dma) {
+      std::ostringstream emuoss;
+      emuoss << "emu-" << std::to_string(m_card_id) << "-" << std::to_string(m_logical_unit);
+      auto dma_source = std::make_unique<EmulatedDMASource>(emuoss.str(), CardWrapper::get_block_size());
+      dma_source->set_rate(tuning.emulated_rate_mbs * 1000000.);
+      std::vector<unsigned int> emulated_elinks(tuning.emulated_elinks.begin(), tuning.emulated_elinks.end());
+      if (emulated_elinks.empty()) {
+        for (auto link : m_links_enabled) {
+          emulated_elinks.push_back(link * m_elink_multiplier);
+        }
+      }
+      dma_source->set_elinks(emulated_elinks);
+      if (!tuning.emulated_template_file.empty()) {
+        dma_source->load_block_templates(tuning.emulated_template_file);
+      }
+      m_card_wrapper->set_dma_source(std::move(dma_source));
+      TLOG(TLVL_WORK_STEPS) << "Card " << m_card_id << " is emulated at "
+                            << (tuning.emulated_rate_mbs > 0 ? std::to_string(tuning.emulated_rate_mbs) + " MB/s" : "full rate");
+    }
+    switch (tuning.wait_strategy) {
+      case felixcardreader::WaitStrategy::sleep:
+        m_card_wrapper->set_wait_strategy(WaitStrategy::kSleep, tuning.dma_spin_count);
+        break;
+      case felixcardreader::WaitStrategy::busy_spin:
+        m_card_wrapper->set_wait_strategy(WaitStrategy::kBusySpin, tuning.dma_spin_count);
+        break;
+      case felixcardreader::WaitStrategy::spin_yield:
+        m_card_wrapper->set_wait_strategy(WaitStrategy::kSpinYield, tuning.dma_spin_count);
+        break;
+      case felixcardreader::WaitStrategy::backoff:
+        m_card_wrapper->set_wait_strategy(WaitStrategy::kBackoff, tuning.dma_spin_count);
+        break;
+      case felixcardreader::WaitStrategy::interrupt:
+        m_card_wrapper->set_wait_strategy(WaitStrategy::kInterrupt, tuning.dma_spin_count);
+        break;
+      default: // as_configured: interrupt_mode and poll_time of the FelixInterface
+        break;
+    }
+    m_card_wrapper->set_block_release_tracking(m_release_tracking);
+    m_card_wrapper->set_fast_restart(tuning.fast_restart);
     m_card_wrapper->configure();
     // get linkids defined by queues
     std::vector<int> linkids;
@@ -216,13 +340,114 @@ FelixReaderModule::do_configure(const data_t& /*args*/)
       elink.key() = tag;
       m_elinks.insert(std::move(elink));
       m_elinks[tag]->set_ids(m_card_id, m_logical_unit, m_links_enabled[i], tag);
+      m_elinks[tag]->set_cpu_affinity(tuning.elink_cpus, m_numa_id);
+      m_elinks[tag]->set_prefetch(tuning.parser_prefetch);
+      m_elinks[tag]->set_overflow_policy(overflow_policy, tuning.overflow_spin_count);
+      m_elinks[tag]->set_idle_spin_count(tuning.elink_spin_count);
+      m_elinks[tag]->set_batch_size(tuning.elink_batch_size);
+      m_elinks[tag]->set_detailed_stats(tuning.parser_detailed_stats);
+      m_elinks[tag]->set_latency_tracking(tuning.latency_histograms);
+      m_elinks[tag]->set_send_timeout(std::chrono::milliseconds(tuning.send_timeout_ms));
+      m_elinks[tag]->set_streaming_copy_threshold(tuning.streaming_copy_threshold);
+      m_elinks[tag]->set_payload_pool(tuning.payload_pool_capacity, tuning.payload_pool_max_size);
+      m_elinks[tag]->set_stale_chunk_timeout(std::chrono::milliseconds(tuning.stale_chunk_timeout_ms));
+      if (m_release_tracking) {
+        m_elinks[tag]->set_block_release_handler(
+          [card_wrapper = m_card_wrapper.get()](uint64_t block_addr) { card_wrapper->release_block(block_addr); }); // NOLINT
+      }
       m_elinks[tag]->conf(m_block_size, is_32b_trailer);
     }
+
+    m_block_recorder.reset();
+    m_record_path = tuning.record_path;
+    m_record_only = tuning.record_only && !m_record_path.empty();
+    if (!m_record_path.empty()) {
+      std::ostringstream recoss;
+      recoss << "rec-" << std::to_string(m_card_id) << "-" << std::to_string(m_logical_unit);
+      m_block_recorder = std::make_unique<BlockRecorder>(recoss.str(),
+                                                         m_block_size,
+                                                         static_cast<std::size_t>(tuning.record_buffer_mb) * 1024 * 1024,
+                                                         m_card_wrapper->get_num_dma_channels());
+      m_block_recorder->set_elinks(tuning.record_elinks);
+      TLOG(TLVL_WORK_STEPS) << "Recording the raw DMA blocks to " << m_record_path
+                            << (m_record_only ? ", without parsing them" : "");
+    }
+
+    // Drop the executor of a previous configuration: the elinks parse on their own thread unless attached again
+    for (auto& [tag, elink] : m_elinks) {
+      elink->set_executor(nullptr, 0);
+    }
+    m_parser_executor.reset();
+    if (tuning.executor_threads > 0) {
+      std::ostringstream exoss;
+      exoss << "epx-" << std::to_string(m_card_id) << "-" << std::to_string(m_logical_unit);
+      m_parser_executor =
+        std::make_unique<ParserExecutor>(exoss.str(), tuning.executor_threads, tuning.elink_cpus, tuning.elink_spin_count);
+      for (auto& [tag, elink] : m_elinks) {
+        m_parser_executor->attach(elink.get());
+      }
+    }
+
+    // Dispatch table of the router
+    m_elink_dispatch.fill(nullptr);
+    for (auto& [tag, elink] : m_elinks) {
+      if (tag < 0 || static_cast<std::size_t>(tag) >= m_max_elinks) {
+        throw ConfigurationError(ERS_HERE, "Elink tag " + std::to_string(tag) + " is out of the block header range");
+      }
+      m_elink_dispatch[tag] = elink.get();
+    }
+}
+
+void
+FelixReaderModule::generate_opmon_data()
+{
+  // The router counts, then marks the counter touched: a count that misses this round is published by the next
+  for (std::size_t word = 0; word < m_unknown_elink_touched.size(); ++word) {
+    auto touched = m_unknown_elink_touched[word].exchange(0, std::memory_order_acquire);
+    while (touched != 0) {
+      std::size_t elink = word * 64 + __builtin_ctzll(touched);
+      touched &= touched - 1;
+      auto num_blocks = m_unknown_elink_ctr[elink].exchange(0);
+      if (num_blocks == 0) {
+        continue;
+      }
+      opmon::UnknownElinkInfo info;
+      info.set_num_blocks(num_blocks);
+      TLOG_DEBUG(TLVL_BOOKKEEPING) << "Discarded " << num_blocks << " blocks with unknown elink " << elink;
+      publish(std::move(info),
+              { { "card", std::to_string(m_card_id) },
+                { "logical_unit", std::to_string(m_logical_unit) },
+                { "elink", std::to_string(elink) } });
+    }
+  }
+
+  if (m_block_recorder) {
+    auto stats = m_block_recorder->get_stats();
+    opmon::RecorderInfo info;
+    info.set_num_blocks_recorded(stats.recorded_blocks);
+    info.set_num_blocks_dropped(stats.dropped_blocks);
+    info.set_num_bytes_written(stats.written_bytes);
+    publish(std::move(info),
+            { { "card", std::to_string(m_card_id) }, { "logical_unit", std::to_string(m_logical_unit) } });
+  }
 }
 
 void
 FelixReaderModule::do_start(const data_t& /*args*/)
 {
+    if (m_block_recorder) {
+      // A new pair of files per run: flxrec-<card>-<logical unit>-<UTC time>.{dat,idx}
+      auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+      std::tm utc{};
+      gmtime_r(&now, &utc);
+      std::ostringstream prefix;
+      prefix << m_record_path << "/flxrec-" << m_card_id << "-" << m_logical_unit << "-"
+             << std::put_time(&utc, "%Y%m%dT%H%M%S");
+      m_block_recorder->open(prefix.str());
+    }
+    if (m_parser_executor) {
+      m_parser_executor->start();
+    }
     m_card_wrapper->start();
     for (auto& [tag, elink] : m_elinks) {
       elink->start();
@@ -232,7 +457,15 @@ FelixReaderModule::do_start(const data_t& /*args*/)
 void
 FelixReaderModule::do_stop(const data_t& /*args*/)
 {
+    // Card first: the elinks drain what was delivered until the DMA processors returned, and release it before
+    // the next start rewinds the rings
     m_card_wrapper->stop();
+    if (m_block_recorder) {
+      m_block_recorder->close();
+    }
+    if (m_parser_executor) {
+      m_parser_executor->stop();
+    }
     for (auto& [tag, elink] : m_elinks) {
       elink->stop();
     }
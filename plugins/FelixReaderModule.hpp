@@ -18,9 +18,14 @@
 // FELIX Software Suite provided
 #include "packetformat/block_format.hpp"
 
+#include "BlockRecorder.hpp"
 #include "CardWrapper.hpp"
 #include "ElinkConcept.hpp"
+#include "FelixStatistics.hpp"
+#include "ParserExecutor.hpp"
 
+#include <array>
+#include <atomic>
 #include <future>
 #include <map>
 #include <memory>
@@ -45,6 +50,9 @@ public:
 
   void init(const std::shared_ptr<appfwk::ConfigurationManager> mcfg) override;
 
+protected:
+  void generate_opmon_data() override;
+
 private:
  
   // Constants
@@ -52,6 +60,7 @@ private:
   static constexpr size_t m_block_queue_capacity = 1000000;
   static constexpr size_t m_1kb_block_size = 1024;
   static constexpr int m_32b_trailer_size = 32;
+  static constexpr std::size_t m_max_elinks = 2048; // 11 bit elink id of the block header
 
   // Commands
   void do_configure(const data_t& args);
@@ -63,20 +72,40 @@ private:
   
   int m_card_id;
   int m_logical_unit;
+  int m_numa_id;
 
   std::vector<unsigned int> m_links_enabled;
   unsigned m_num_links;
   std::size_t m_block_size;
   int m_chunk_trailer_size;
+  bool m_release_tracking{ false };
+  std::size_t m_prefetch_blocks{ 0 };
 
   // FELIX Cards
-  std::unique_ptr<CardWrapper> m_card_wrapper;
+  std::shared_ptr<CardWrapper> m_card_wrapper;
 
   // ElinkConcept
   std::map<int, std::shared_ptr<ElinkConcept>> m_elinks;
 
-  // Function for routing block addresses from card to elink handler
-  std::function<void(uint64_t)> m_block_router; // NOLINT
+  // Optional recorder of the raw DMA blocks, to a new pair of files in m_record_path on every start
+  std::unique_ptr<BlockRecorder> m_block_recorder;
+  std::string m_record_path;
+  bool m_record_only{ false };
+
+  // Optional shared executor of the elink parsers
+  std::unique_ptr<ParserExecutor> m_parser_executor;
+
+  // Dispatch table of the router, indexed by elink id. Filled at configure, nullptr for unknown elinks.
+  std::array<ElinkConcept*, m_max_elinks> m_elink_dispatch{};
+
+  // Blocks discarded by the router, per unknown elink id, and a bit per counter touched since the last
+  // generate_opmon_data, which only visits those
+  std::array<stats::counter_t, m_max_elinks> m_unknown_elink_ctr{};
+  std::array<std::atomic<uint64_t>, m_max_elinks / 64> m_unknown_elink_touched{}; // NOLINT(build/unsigned)
+
+  // Function for routing contiguous ranges of block addresses from card to elink handlers
+  std::function<void(uint64_t, std::size_t, uint64_t, std::size_t)> m_block_batch_router; // NOLINT
+  void route_block(uint64_t block_addr, uint64_t window_ns); // NOLINT
 };
 
 } // namespace dunedaq::flxlibs
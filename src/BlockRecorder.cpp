@@ -0,0 +1,287 @@
+/**
+ * @file BlockRecorder.cpp Recorder of raw DMA blocks implementation
+ *
+ * This is part of the DUNE DAQ , copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+// From Module
+#include "BlockRecorder.hpp"
+#include "FelixIssues.hpp"
+
+#include "logging/Logging.hpp"
+
+#include "packetformat/block_format.hpp"
+
+// From STD
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/**
+ * @brief TRACE debug levels used in this source file
+ */
+enum
+{
+  TLVL_ENTER_EXIT_METHODS = 5,
+  TLVL_WORK_STEPS = 10,
+  TLVL_BOOKKEEPING = 15
+};
+
+namespace dunedaq {
+namespace flxlibs {
+
+BlockRecorder::BlockRecorder(const std::string& name,
+                             std::size_t block_size,
+                             std::size_t buffer_size,
+                             std::size_t num_channels)
+  : m_name(name)
+  , m_block_size(block_size)
+  , m_segment_size(s_segment_size / block_size * block_size)
+{
+  // At least two segments per channel, so its DMA processor can stage one while the other is written
+  num_channels = std::max<std::size_t>(num_channels, 1);
+  auto segments_per_channel = std::max<std::size_t>(buffer_size / s_segment_size / num_channels, 2);
+  auto num_segments = segments_per_channel * num_channels;
+  m_memory.reset(static_cast<char*>(std::aligned_alloc(s_alignment, num_segments * s_segment_size)));
+  if (!m_memory) {
+    throw BlockRecorderError(ERS_HERE, m_name, "couldn't allocate " + std::to_string(num_segments) + " segments");
+  }
+  m_segments.resize(num_segments);
+  for (std::size_t i = 0; i < num_segments; ++i) {
+    m_segments[i].data = m_memory.get() + i * s_segment_size;
+    m_segments[i].index.reserve(m_segment_size / m_block_size);
+  }
+  for (std::size_t channel = 0; channel < num_channels; ++channel) {
+    auto& stage = m_stages.emplace_back(std::make_unique<Stage>(segments_per_channel));
+    for (std::size_t i = 0; i < segments_per_channel; ++i) {
+      stage->free.write(&m_segments[channel * segments_per_channel + i]);
+    }
+  }
+}
+
+BlockRecorder::~BlockRecorder()
+{
+  close();
+}
+
+void
+BlockRecorder::set_elinks(const std::vector<int>& elinks)
+{
+  m_elinks.reset();
+  for (auto elink : elinks) {
+    if (elink < 0 || static_cast<std::size_t>(elink) >= m_elinks.size()) {
+      throw ConfigurationError(ERS_HERE, "Recorded elink " + std::to_string(elink) + " is out of the block header range");
+    }
+    m_elinks.set(elink);
+  }
+  m_all_elinks = elinks.empty();
+}
+
+void
+BlockRecorder::open(const std::string& path_prefix)
+{
+  close();
+  auto data_path = path_prefix + ".dat";
+  m_fd = ::open(data_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644); // NOLINT
+  m_direct = m_fd >= 0;
+  if (m_fd < 0 && errno == EINVAL) {
+    // The file system doesn't support direct IO: go through the page cache
+    ers::warning(BlockRecorderError(ERS_HERE, m_name, "no O_DIRECT support for " + data_path + ", using buffered writes"));
+    m_fd = ::open(data_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644); // NOLINT
+  }
+  if (m_fd < 0) {
+    throw BlockRecorderError(ERS_HERE, m_name, "couldn't open " + data_path + ": " + std::strerror(errno));
+  }
+  auto index_path = path_prefix + ".idx";
+  m_index_fd = ::open(index_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644); // NOLINT
+  if (m_index_fd < 0) {
+    auto error = errno;
+    ::close(m_fd);
+    m_fd = -1;
+    throw BlockRecorderError(ERS_HERE, m_name, "couldn't open " + index_path + ": " + std::strerror(error));
+  }
+
+  m_written_offset = 0;
+  m_index_offset = 0;
+  m_failed = false;
+  m_closing = false;
+  m_writer_parker.reset();
+  m_writer = std::thread(&BlockRecorder::run, this);
+  m_open.store(true, std::memory_order_release);
+  TLOG_DEBUG(TLVL_WORK_STEPS) << "Recording blocks to " << data_path << (m_direct ? " with direct IO" : "");
+}
+
+void
+BlockRecorder::close()
+{
+  if (!m_open.exchange(false)) {
+    return;
+  }
+  // The DMA processors are stopped: hand their partly filled segments over too
+  for (auto& stage : m_stages) {
+    if (stage->current != nullptr) {
+      stage->ready.write(stage->current);
+      stage->current = nullptr;
+    }
+  }
+  m_closing.store(true, std::memory_order_release);
+  m_writer_parker.interrupt();
+  if (m_writer.joinable()) {
+    m_writer.join();
+  }
+  ::close(m_fd);
+  m_fd = -1;
+  ::close(m_index_fd);
+  m_index_fd = -1;
+  TLOG_DEBUG(TLVL_WORK_STEPS) << "Closed the recording of " << m_name << " after " << m_written_offset << " bytes";
+}
+
+void
+BlockRecorder::record(std::size_t channel, uint64_t first_block_addr, std::size_t num_blocks, std::size_t stride) // NOLINT
+{
+  if (!m_open.load(std::memory_order_acquire) || m_failed.load(std::memory_order_relaxed)) {
+    return;
+  }
+  auto& stage = *m_stages[channel];
+  uint64_t recorded = 0; // NOLINT(build/unsigned)
+  uint64_t dropped = 0;  // NOLINT(build/unsigned)
+  bool handed_over = false;
+  for (std::size_t i = 0; i < num_blocks; ++i) {
+    const char* data = reinterpret_cast<const char*>(first_block_addr + i * stride); // NOLINT
+    const auto* block = felix::packetformat::block_from_bytes(data);
+    if (!m_all_elinks && !m_elinks.test(block->elink)) {
+      continue;
+    }
+    if (stage.current == nullptr && !stage.free.read(stage.current)) {
+      ++dropped; // the disk doesn't keep up
+      continue;
+    }
+    auto& segment = *stage.current;
+    std::memcpy(segment.data + segment.used, data, m_block_size);
+    segment.index.push_back({ segment.used, block->elink, block->seqnr });
+    segment.used += m_block_size;
+    ++recorded;
+    if (segment.used == m_segment_size) {
+      stage.ready.write(stage.current); // never full: it has room for all the segments of the channel
+      stage.current = nullptr;
+      handed_over = true;
+    }
+  }
+  if (handed_over) {
+    m_writer_parker.unpark();
+  }
+  m_recorded_blocks.fetch_add(recorded, std::memory_order_relaxed);
+  m_dropped_blocks.fetch_add(dropped, std::memory_order_relaxed);
+}
+
+BlockRecorder::Stats
+BlockRecorder::get_stats()
+{
+  return { m_recorded_blocks.exchange(0, std::memory_order_relaxed),
+           m_dropped_blocks.exchange(0, std::memory_order_relaxed),
+           m_written_bytes.exchange(0, std::memory_order_relaxed) };
+}
+
+bool
+BlockRecorder::has_ready_segments()
+{
+  for (auto& stage : m_stages) {
+    if (!stage->ready.isEmpty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void
+BlockRecorder::run()
+{
+  pthread_setname_np(pthread_self(), m_name.substr(0, 15).c_str());
+  while (true) {
+    // Closing is published after the last segments were handed over: once seen, a pass finding none is the last
+    bool closing = m_closing.load(std::memory_order_acquire);
+    bool written = false;
+    for (auto& stage : m_stages) {
+      Segment* segment = nullptr;
+      while (stage->ready.read(segment)) {
+        write_segment(*segment);
+        segment->used = 0;
+        segment->index.clear();
+        stage->free.write(segment);
+        written = true;
+      }
+    }
+    if (!written) {
+      if (closing) {
+        break;
+      }
+      m_writer_parker.park([this]() { return has_ready_segments(); }, s_max_park_time);
+    }
+  }
+}
+
+void
+BlockRecorder::write_segment(Segment& segment)
+{
+  if (m_failed) {
+    return;
+  }
+  auto size = segment.used;
+  auto segment_offset = m_written_offset;
+  if (m_direct && size % s_alignment != 0) {
+    // Only the last segments of a recording can end unaligned: write the aligned part directly, and from there on
+    // go through the page cache
+    auto aligned_size = size / s_alignment * s_alignment;
+    if (!write_file(m_fd, segment.data, aligned_size, m_written_offset)) {
+      return;
+    }
+    ::fcntl(m_fd, F_SETFL, ::fcntl(m_fd, F_GETFL) & ~O_DIRECT); // NOLINT
+    m_direct = false;
+    if (!write_file(m_fd, segment.data + aligned_size, size - aligned_size, m_written_offset)) {
+      return;
+    }
+  } else if (!write_file(m_fd, segment.data, size, m_written_offset)) {
+    return;
+  }
+  m_written_bytes.fetch_add(size, std::memory_order_relaxed);
+  for (auto& entry : segment.index) {
+    entry.offset += segment_offset;
+  }
+  write_file(m_index_fd,
+             reinterpret_cast<const char*>(segment.index.data()), // NOLINT
+             segment.index.size() * sizeof(IndexEntry),
+             m_index_offset);
+}
+
+bool
+BlockRecorder::write_file(int fd, const char* data, std::size_t size, uint64_t& offset) // NOLINT(build/unsigned)
+{
+  while (size > 0) {
+    auto written = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      m_failed = true;
+      ers::error(BlockRecorderError(ERS_HERE,
+                                    m_name,
+                                    std::string(fd == m_index_fd ? "writing the index" : "writing the data") +
+                                      " failed, stopping the recording: " + std::strerror(errno)));
+      return false;
+    }
+    data += written;
+    size -= written;
+    offset += written;
+  }
+  return true;
+}
+
+} // namespace flxlibs
+} // namespace dunedaq
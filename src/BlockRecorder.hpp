@@ -0,0 +1,138 @@
+/**
+ * @file BlockRecorder.hpp Recorder of raw DMA blocks to disk. The DMA
+ * processors copy the blocks of the recorded elinks into aligned staging
+ * segments of their own, and hand the full ones over lock-free to a writer
+ * thread. It streams them to a data file with O_DIRECT writes, next to an
+ * index of the recorded blocks.
+ *
+ * This is part of the DUNE DAQ , copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef FLXLIBS_SRC_BLOCKRECORDER_HPP_
+#define FLXLIBS_SRC_BLOCKRECORDER_HPP_
+
+#include "WaitStrategy.hpp"
+
+#include <folly/ProducerConsumerQueue.h>
+
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace dunedaq::flxlibs {
+
+class BlockRecorder
+{
+public:
+  // Entry of the index file, one per recorded block, in file order
+  struct IndexEntry
+  {
+    uint64_t offset; // NOLINT(build/unsigned) in the data file
+    uint32_t elink;  // NOLINT(build/unsigned)
+    uint32_t seqnr;  // NOLINT(build/unsigned) 5 bit sequence number of the block header
+  };
+
+  struct Stats
+  {
+    uint64_t recorded_blocks; // NOLINT(build/unsigned)
+    uint64_t dropped_blocks;  // NOLINT(build/unsigned)
+    uint64_t written_bytes;   // NOLINT(build/unsigned)
+  };
+
+  /**
+   * @brief BlockRecorder Constructor
+   * @param name Name of the writer thread
+   * @param block_size Size of the recorded DMA blocks
+   * @param buffer_size Memory of the staging segments, split between the DMA channels. Blocks arriving while all
+   * the segments of their channel wait for the disk are dropped.
+   * @param num_channels Number of DMA channels calling record
+   */
+  BlockRecorder(const std::string& name, std::size_t block_size, std::size_t buffer_size, std::size_t num_channels);
+  ~BlockRecorder();
+  BlockRecorder(const BlockRecorder&) = delete;            ///< BlockRecorder is not copy-constructible
+  BlockRecorder& operator=(const BlockRecorder&) = delete; ///< BlockRecorder is not copy-assignable
+  BlockRecorder(BlockRecorder&&) = delete;                 ///< BlockRecorder is not move-constructible
+  BlockRecorder& operator=(BlockRecorder&&) = delete;      ///< BlockRecorder is not move-assignable
+
+  // Elink ids to record, empty for all of them. To be called while closed.
+  void set_elinks(const std::vector<int>& elinks);
+
+  // Creates <path_prefix>.dat and <path_prefix>.idx and starts the writer thread
+  void open(const std::string& path_prefix);
+  // Writes out the staged blocks and closes the files. The DMA processors have to be stopped first.
+  void close();
+
+  // Called by the DMA processor of channel with a contiguous range of block addresses, stride apart. A channel is
+  // recorded from a single thread at a time.
+  void record(std::size_t channel, uint64_t first_block_addr, std::size_t num_blocks, std::size_t stride); // NOLINT
+
+  // Counters since the last call
+  Stats get_stats();
+
+private:
+  struct Segment
+  {
+    char* data{ nullptr }; // s_alignment aligned, m_segment_size bytes
+    std::size_t used{ 0 };
+    std::vector<IndexEntry> index; // offsets in the segment, until the writer places it in the file
+  };
+
+  // Segments of a DMA channel: its processor fills them, the writer empties them. Both queues are single
+  // producer, single consumer, with room for all the segments.
+  struct Stage
+  {
+    explicit Stage(std::size_t num_segments)
+      : ready(num_segments + 1)
+      , free(num_segments + 1)
+    {}
+    folly::ProducerConsumerQueue<Segment*> ready; // full, to be written
+    folly::ProducerConsumerQueue<Segment*> free;  // written, to be filled again
+    Segment* current{ nullptr };                  // being filled, owned by the processor
+  };
+
+  static constexpr std::size_t s_alignment = 4096; // O_DIRECT alignment of buffers, offsets and sizes
+  static constexpr std::size_t s_segment_size = 4 * 1024 * 1024;
+  static constexpr std::chrono::microseconds s_max_park_time{ 100000 };
+
+  void run();
+  bool has_ready_segments();
+  void write_segment(Segment& segment);
+  bool write_file(int fd, const char* data, std::size_t size, uint64_t& offset); // NOLINT(build/unsigned)
+
+  std::string m_name;
+  std::size_t m_block_size;
+  std::size_t m_segment_size;
+  std::bitset<2048> m_elinks; // 11 bit elink id of the block header
+  bool m_all_elinks{ true };
+
+  std::unique_ptr<char, void (*)(void*)> m_memory{ nullptr, std::free }; // of all the segments
+  std::vector<Segment> m_segments;
+  std::vector<std::unique_ptr<Stage>> m_stages; // per DMA channel
+  std::atomic<bool> m_open{ false };
+  std::atomic<bool> m_closing{ false };
+
+  // Writer
+  std::thread m_writer;
+  Parker m_writer_parker; // until a segment is ready
+  int m_fd{ -1 };
+  int m_index_fd{ -1 };
+  bool m_direct{ false };
+  std::atomic<bool> m_failed{ false }; // a write failed: the rest of the recording is discarded
+  uint64_t m_written_offset{ 0 };      // NOLINT(build/unsigned)
+  uint64_t m_index_offset{ 0 };        // NOLINT(build/unsigned)
+
+  std::atomic<uint64_t> m_recorded_blocks{ 0 }; // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_dropped_blocks{ 0 };  // NOLINT(build/unsigned)
+  std::atomic<uint64_t> m_written_bytes{ 0 };   // NOLINT(build/unsigned)
+};
+
+} // namespace dunedaq::flxlibs
+
+#endif // FLXLIBS_SRC_BLOCKRECORDER_HPP_
@@ -7,18 +7,22 @@
  */
 // From Module
 #include "CardWrapper.hpp"
-#include "FelixDefinitions.hpp"
 #include "FelixIssues.hpp"
+#include "FlxCardDMASource.hpp"
+#include "ThreadAffinity.hpp"
 
 #include "logging/Logging.hpp"
 
-#include "flxcard/FlxException.h"
+#include "flxlibs/opmon/CardWrapper.pb.h"
+
 #include "packetformat/block_format.hpp"
 
 // From STD
+#include <algorithm>
 #include <chrono>
 #include <memory>
 #include <string>
+#include <utility>
 
 /**
  * @brief TRACE debug levels used in this source file
@@ -33,36 +37,53 @@ enum
 namespace dunedaq {
 namespace flxlibs {
 
+namespace {
+
+CardWrapper::Settings
+settings_of(const appmodel::FelixInterface* cfg)
+{
+  CardWrapper::Settings settings;
+  settings.card_id = cfg->get_card();
+  settings.logical_unit = cfg->get_slr();
+  settings.dma_id = cfg->get_dma_id();
+  settings.margin_blocks = cfg->get_dma_margin_blocks();
+  settings.block_threshold = cfg->get_dma_block_threshold();
+  settings.interrupt_mode = cfg->get_interrupt_mode();
+  settings.poll_time = cfg->get_poll_time();
+  settings.numa_id = cfg->get_numa_id();
+  settings.dma_memory_size = cfg->get_dma_memory_size_gb() * 1024 * 1024 * 1024UL;
+  return settings;
+}
+
+} // namespace
+
 CardWrapper::CardWrapper(const appmodel::FelixInterface * cfg, std::vector<unsigned int> enabled_links)
+  : CardWrapper(settings_of(cfg), std::move(enabled_links))
+{}
+
+CardWrapper::CardWrapper(const Settings& settings, std::vector<unsigned int> enabled_links)
   : m_run_marker{ false }
-  , m_card_id(cfg->get_card())
-  , m_logical_unit(cfg->get_slr())
-  , m_dma_id(cfg->get_dma_id())
-  , m_margin_blocks(cfg->get_dma_margin_blocks())
-  , m_block_threshold(cfg->get_dma_block_threshold())
-  , m_interrupt_mode(cfg->get_interrupt_mode())
-  , m_poll_time(cfg->get_poll_time())
-  , m_numa_id(cfg->get_numa_id())
+  , m_card_id(settings.card_id)
+  , m_logical_unit(settings.logical_unit)
+  , m_dma_ids{ settings.dma_id }
+  , m_margin_blocks(settings.margin_blocks)
+  , m_block_threshold(settings.block_threshold)
+  , m_interrupt_mode(settings.interrupt_mode)
+  , m_poll_time(settings.poll_time)
+  , m_numa_id(settings.numa_id)
+  , m_links_enabled(std::move(enabled_links))
   , m_info_str("")
+  , m_wait_strategy(m_interrupt_mode ? WaitStrategy::kInterrupt : WaitStrategy::kSleep)
   , m_run_lock{ false }
-  , m_dma_processor(0)
   , m_handle_block_addr(nullptr)
-  , m_links_enabled(enabled_links)
 {
-  m_dma_memory_size = cfg->get_dma_memory_size_gb() * 1024 * 1024 * 1024UL;
-
-  std::ostringstream tnoss;
-  tnoss << m_dma_processor_name << "-" << std::to_string(m_card_id); // append physical card id
-  m_dma_processor.set_name(tnoss.str(), m_logical_unit); // set_name appends logical unit id
+  m_dma_memory_size = settings.dma_memory_size;
 
   std::ostringstream cardoss;
   cardoss << "[id:" << std::to_string(m_card_id) << " slr:" << std::to_string(m_logical_unit) << "]";
   m_card_id_str = cardoss.str();
 
-  m_flx_card = std::make_unique<FlxCard>();
-  if (m_flx_card == nullptr) {
-    throw flxlibs::CardError(ERS_HERE, "Couldn't create FlxCard object.");
-  }
+  m_dma_source = std::make_unique<FlxCardDMASource>(m_card_id, m_logical_unit, m_card_id_str);
 }
 
 CardWrapper::~CardWrapper()
@@ -84,19 +105,40 @@ CardWrapper::configure()
     // Open card
     open_card();
     TLOG_DEBUG(TLVL_WORK_STEPS) << "Card[" << m_card_id_str << "] opened.";
-    // Allocate CMEM
-    m_cmem_handle = allocate_CMEM(m_numa_id, m_dma_memory_size, &m_phys_addr, &m_virt_addr);
-    TLOG_DEBUG(TLVL_WORK_STEPS) << "Card[" << m_card_id_str << "] CMEM memory allocated with "
-                                << std::to_string(m_dma_memory_size) << " Bytes.";
+    // Allocate CMEM for every DMA descriptor
+    for (std::size_t i = 0; i < m_dma_ids.size(); ++i) {
+      auto numa_id = (i < m_numa_ids.size()) ? m_numa_ids[i] : m_numa_id;
+      auto channel = std::make_unique<DMAChannel>(i, m_dma_ids[i], numa_id);
+      channel->cmem_handle = allocate_CMEM(numa_id, m_dma_memory_size, &channel->phys_addr, &channel->virt_addr);
+      if (m_release_tracking) {
+        channel->block_in_use = std::make_unique<std::atomic<uint8_t>[]>(m_dma_memory_size / m_block_size); // NOLINT
+        for (auto slot = channel->virt_addr / m_dma_memory_size;
+             slot <= (channel->virt_addr + m_dma_memory_size - 1) / m_dma_memory_size;
+             ++slot) {
+          auto& rings = m_release_slots[slot];
+          rings[rings[0] == nullptr ? 0 : 1] = channel.get();
+        }
+      }
+      channel->dma_waiter.configure(m_wait_strategy, std::chrono::microseconds(m_poll_time), m_spin_count);
+      std::ostringstream tnoss;
+      tnoss << m_dma_processor_name << "-" << std::to_string(m_card_id) // append physical card id
+            << "-" << std::to_string(m_logical_unit);                   // and logical unit id
+      channel->dma_processor.set_name(tnoss.str(), channel->dma_id);    // set_name appends DMA id
+      channel->name = tnoss.str() + "-" + std::to_string(channel->dma_id);
+      validate_cpu_affinity(m_dma_cpus, numa_id, channel->name);
+      m_dma_channels.push_back(std::move(channel));
+      TLOG_DEBUG(TLVL_WORK_STEPS) << "Card[" << m_card_id_str << "] CMEM memory allocated with "
+                                  << std::to_string(m_dma_memory_size) << " Bytes for DMA "
+                                  << std::to_string(m_dma_ids[i]) << " on NUMA " << std::to_string(numa_id) << ".";
+    }
     // Stop currently running DMA
     stop_DMA();
     TLOG_DEBUG(TLVL_WORK_STEPS) << "Card[" << m_card_id_str << "] DMA interactions force stopped.";
     // Init DMA between software and card
     init_DMA();
     TLOG_DEBUG(TLVL_WORK_STEPS) << "Card[" << m_card_id_str << "] DMA access initialized.";
-    // The rest was some CPU pinning.
     TLOG_DEBUG(TLVL_WORK_STEPS) << m_card_id_str << "] is configured for datataking.";
-    m_configured = true;
+    m_configured.store(true, std::memory_order_release);
   }
 }
 
@@ -105,12 +147,21 @@ CardWrapper::start()
 {
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << "Starting CardWrapper of card " << m_card_id_str << "...";
   if (!m_run_marker.load()) {
-    if (!m_block_addr_handler_available) {
+    if (!m_block_addr_handler_available && !m_block_batch_handler_available) {
       TLOG() << "Block Address handler is not set! Is it intentional?";
     }
+    // The consumers of the previous run are stopped and released what they held: start from clean rings
+    rewind_DMA();
     start_DMA();
     set_running(true);
-    m_dma_processor.set_work(&CardWrapper::process_DMA, this);
+    {
+      std::lock_guard<std::mutex> lk(m_processors_mutex);
+      m_active_processors = m_dma_channels.size();
+    }
+    for (auto& channel : m_dma_channels) {
+      channel->dma_waiter.reset();
+      channel->dma_processor.set_work(&CardWrapper::run_DMA_processor, this, channel.get());
+    }
     TLOG() << "Started CardWrapper of card " << m_card_id_str << "...";
   } else {
     TLOG() << "CardWrapper of card " << m_card_id_str << " is already running!";
@@ -123,11 +174,30 @@ CardWrapper::graceful_stop()
   TLOG_DEBUG(TLVL_ENTER_EXIT_METHODS) << "Stopping CardWrapper of card " << m_card_id_str << "...";
   if (m_run_marker.load()) {
     set_running(false);
-    while (!m_dma_processor.get_readiness()) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    // Wake up the processors wherever they wait. An interrupt cancel can race with the processor entering
+    // the wait, so it is repeated until every processor returned.
+    std::unique_lock<std::mutex> lk(m_processors_mutex);
+    do {
+      for (auto& channel : m_dma_channels) {
+        channel->dma_waiter.interrupt();
+        if (m_interrupt_mode) {
+          m_dma_source->cancel_wait(channel->dma_id);
+        }
+      }
+    } while (!m_processors_cv.wait_for(lk, std::chrono::milliseconds(1), [&]() { return m_active_processors == 0; }));
+    lk.unlock();
+    // The threads become ready as soon as the processors returned
+    for (auto& channel : m_dma_channels) {
+      while (!channel->dma_processor.get_readiness()) {
+        std::this_thread::yield();
+      }
     }
+    // Every delivered block was queued to the consumers before the processors returned. The consumers may still
+    // parse and release them: the rings are only rewound by the next start, once the consumers are stopped too.
     stop_DMA();
-    init_DMA();
+    if (!m_fast_restart) {
+      init_DMA();
+    }
     TLOG() << "Stopped CardWrapper of card " << m_card_id_str << "!";
   } else {
     TLOG() << "CardWrapper of card " << m_card_id_str << " is already stopped!";
@@ -148,146 +218,260 @@ CardWrapper::set_running(bool should_run)
 }
 
 void
-CardWrapper::open_card()
+CardWrapper::set_wait_strategy(WaitStrategy strategy, std::size_t spin_count)
 {
-  TLOG_DEBUG(TLVL_WORK_STEPS) << "Opening FELIX card (with DMA lock mask)" << m_card_id_str;
-  try {
-    m_card_mutex.lock();
-    auto absolute_card_id = m_card_id + m_logical_unit;
-    u_int current_lock_mask = m_flx_card->get_lock_mask(absolute_card_id);
-    TLOG_DEBUG(TLVL_WORK_STEPS) << "Current lock mask for FELIX card " << m_card_id_str << " mask:" << int(current_lock_mask);
-    u_int to_lock_mask = u_int(m_dma_id+1);
-    if (current_lock_mask & to_lock_mask) { // LOCK_NONE=0, LOCK_DMA0=1, LOCK_DMA1=2 from FlxCard.h
-      ers::fatal(flxlibs::CardError(ERS_HERE, "FELIX card's DMA is locked by another process!"));
-      exit(EXIT_FAILURE);
-    }
-    m_flx_card->card_open(static_cast<int>(absolute_card_id), to_lock_mask); // FlxCard.h
-    m_card_mutex.unlock();
-  } catch (FlxException& ex) {
-    ers::error(flxlibs::CardError(ERS_HERE, ex.what()));
-    exit(EXIT_FAILURE);
+  if (m_configured) {
+    throw flxlibs::ConfigurationError(ERS_HERE, "DMA wait strategy can't be changed after configuration.");
   }
+  m_interrupt_mode = (strategy == WaitStrategy::kInterrupt);
+  m_wait_strategy = strategy;
+  m_spin_count = spin_count;
 }
 
 void
-CardWrapper::close_card()
+CardWrapper::set_dma_ids(const std::vector<uint8_t>& dma_ids, const std::vector<uint8_t>& numa_ids) // NOLINT
 {
-  TLOG_DEBUG(TLVL_WORK_STEPS) << "Closing FELIX card " << m_card_id_str;
-  try {
-    m_card_mutex.lock();
-    m_flx_card->card_close();
-    m_card_mutex.unlock();
-  } catch (FlxException& ex) {
-    ers::error(flxlibs::CardError(ERS_HERE, ex.what()));
-    exit(EXIT_FAILURE);
+  if (m_configured) {
+    throw flxlibs::ConfigurationError(ERS_HERE, "DMA descriptors can't be changed after configuration.");
+  }
+  if (dma_ids.empty()) {
+    throw flxlibs::ConfigurationError(ERS_HERE, "At least one DMA descriptor is needed.");
   }
+  m_dma_ids = dma_ids;
+  m_numa_ids = numa_ids;
 }
 
-int
-CardWrapper::allocate_CMEM(uint8_t numa, u_long bsize, u_long* paddr, u_long* vaddr) // NOLINT
+void
+CardWrapper::set_block_release_tracking(bool enable)
 {
-  TLOG_DEBUG(TLVL_WORK_STEPS) << "Allocating CMEM buffer " << m_card_id_str << " dma id:" << std::to_string(m_dma_id);
-  int handle;
-  unsigned ret = CMEM_Open(); // cmem_rcc.h
-  if (!ret) {
-    ret = CMEM_NumaSegmentAllocate(bsize, numa, const_cast<char*>(m_card_id_str.c_str()), &handle); // NUMA aware
-    // ret = CMEM_GFPBPASegmentAllocate(bsize, const_cast<char*>(m_card_id_str.c_str()), &handle); // non NUMA aware
+  if (m_configured) {
+    throw flxlibs::ConfigurationError(ERS_HERE, "DMA block release tracking can't be changed after configuration.");
   }
-  if (!ret) {
-    ret = CMEM_SegmentPhysicalAddress(handle, paddr);
+  m_release_tracking = enable;
+}
+
+void
+CardWrapper::release_block(uint64_t block_addr) // NOLINT(build/unsigned)
+{
+  auto slot = m_release_slots.find(block_addr / m_dma_memory_size);
+  if (slot == m_release_slots.end()) {
+    return;
   }
-  if (!ret) {
-    ret = CMEM_SegmentVirtualAddress(handle, vaddr);
+  for (auto* channel : slot->second) {
+    if (channel != nullptr && block_addr >= channel->virt_addr && block_addr < channel->virt_addr + m_dma_memory_size) {
+      // Release: the consumer is done reading the block before the DMA processor may hand it back to the card
+      channel->block_in_use[(block_addr - channel->virt_addr) / m_block_size].store(0, std::memory_order_release);
+      return;
+    }
   }
-  if (ret) {
-    // rcc_error_print(stdout, ret);
-    m_card_mutex.lock();
-    m_flx_card->card_close();
-    m_card_mutex.unlock();
-    ers::fatal(
-      flxlibs::CardError(ERS_HERE,
-                         "Not enough CMEM memory allocated or the application demands too much CMEM memory.\n"
-                         "Fix the CMEM memory reservation in the driver or change the module's configuration."));
-    exit(EXIT_FAILURE);
+}
+
+void
+CardWrapper::set_dma_source(std::unique_ptr<DMASource> dma_source)
+{
+  if (m_configured) {
+    throw flxlibs::ConfigurationError(ERS_HERE, "DMA source can't be replaced after configuration.");
   }
-  return handle;
+  m_dma_source = std::move(dma_source);
+}
+
+void
+CardWrapper::open_card()
+{
+  m_dma_source->open_card(m_dma_ids);
+}
+
+void
+CardWrapper::close_card()
+{
+  m_dma_source->close_card();
+}
+
+int
+CardWrapper::allocate_CMEM(uint8_t numa, u_long bsize, u_long* paddr, u_long* vaddr) // NOLINT
+{
+  return m_dma_source->allocate_buffer(numa, bsize, paddr, vaddr);
 }
 
 void
 CardWrapper::init_DMA()
 {
-  TLOG_DEBUG(TLVL_WORK_STEPS) << "InitDMA issued...";
-  m_card_mutex.lock();
-  m_flx_card->dma_reset();
-  TLOG_DEBUG(TLVL_WORK_STEPS) << "flxCard.dma_reset issued.";
-  m_flx_card->soft_reset();
-  TLOG_DEBUG(TLVL_WORK_STEPS) << "flxCard.soft_reset issued.";
-  m_flx_card->irq_reset_counters();
-  TLOG_DEBUG(TLVL_WORK_STEPS) << "flxCard.irq_reset_counters issued.";
-  // interrupted or polled DMA processing
-  if (m_interrupt_mode) {
-#if REGMAP_VERSION < 0x500
-    m_flx_card->irq_enable(IRQ_DATA_AVAILABLE);
-#else
-    m_flx_card->irq_enable(IRQ_DATA_AVAILABLE + m_dma_id);
-#endif
-    TLOG_DEBUG(TLVL_WORK_STEPS) << "flxCard.irq_enable issued.";
-  } else {
-    m_flx_card->irq_disable();
-    TLOG_DEBUG(TLVL_WORK_STEPS) << "flxCard.irq_disable issued.";
-  }
-  m_card_mutex.unlock();
-  m_current_addr = m_phys_addr;
-  m_destination = m_phys_addr;
-  m_read_index = 0;
+  m_dma_source->init_DMA(m_dma_ids, m_interrupt_mode);
   TLOG_DEBUG(TLVL_WORK_STEPS) << "flxCard initDMA done card[" << m_card_id_str << "]";
 }
 
+void
+CardWrapper::rewind_DMA()
+{
+  // start_DMA programs the descriptors from the start of the rings again
+  for (auto& channel : m_dma_channels) {
+    channel->current_addr = channel->phys_addr;
+    channel->destination = channel->phys_addr;
+    channel->read_index = 0;
+    channel->release_index = 0;
+    if (channel->block_in_use) {
+      for (std::size_t i = 0; i < m_dma_memory_size / m_block_size; ++i) {
+        channel->block_in_use[i].store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+}
+
 void
 CardWrapper::start_DMA()
 {
-  TLOG_DEBUG(TLVL_WORK_STEPS) << "Issuing flxCard.dma_to_host for card " << m_card_id_str
-                              << " dma id:" << std::to_string(m_dma_id);
-  m_card_mutex.lock();
-  m_flx_card->dma_to_host(m_dma_id, m_phys_addr, m_dma_memory_size, m_dma_wraparound); // FlxCard.h
-  m_card_mutex.unlock();
+  for (auto& channel : m_dma_channels) {
+    m_dma_source->start_DMA(channel->dma_id, channel->phys_addr, m_dma_memory_size);
+  }
 }
 
 void
 CardWrapper::stop_DMA()
 {
-  TLOG_DEBUG(TLVL_WORK_STEPS) << "Issuing flxCard.dma_stop for card " << m_card_id_str
-                              << " dma id:" << std::to_string(m_dma_id);
-  m_card_mutex.lock();
-  m_flx_card->dma_stop(m_dma_id);
-  m_card_mutex.unlock();
+  for (auto& channel : m_dma_channels) {
+    m_dma_source->stop_DMA(channel->dma_id);
+  }
 }
 
 inline uint64_t // NOLINT
-CardWrapper::bytes_available()
+CardWrapper::bytes_available(const DMAChannel& channel)
 {
-  return (m_current_addr - ((m_read_index * m_block_size) + m_phys_addr) + m_dma_memory_size) % m_dma_memory_size;
+  return (channel.current_addr - ((channel.read_index * m_block_size) + channel.phys_addr) + m_dma_memory_size) %
+         m_dma_memory_size;
 }
 
 void
-CardWrapper::read_current_address()
+CardWrapper::read_current_address(DMAChannel& channel)
 {
-  m_card_mutex.lock();
-  m_current_addr = m_flx_card->m_bar0->DMA_DESC_STATUS[m_dma_id].current_address;
-  m_card_mutex.unlock();
+  channel.current_addr = m_dma_source->read_current_address(channel.dma_id);
 }
 
 void
-CardWrapper::process_DMA()
+CardWrapper::acquire_blocks(DMAChannel& channel, unsigned first_index, unsigned end_index)
 {
-  TLOG_DEBUG(TLVL_WORK_STEPS) << "CardWrapper starts processing blocks...";
+  // Flags are published to the consumers together with the block addresses (queue writes are releases)
+  for (unsigned i = first_index; i != end_index; ++i) {
+    channel.block_in_use[i].store(1, std::memory_order_relaxed);
+  }
+}
+
+void
+CardWrapper::update_read_pointer(DMAChannel& channel)
+{
+  // Without release tracking, blocks are given back as soon as they are delivered.
+  // Otherwise, advance up to the oldest block a consumer still references.
+  unsigned free_index = channel.read_index;
+  if (m_release_tracking) {
+    const unsigned num_blocks = m_dma_memory_size / m_block_size;
+    while (channel.release_index != channel.read_index &&
+           channel.block_in_use[channel.release_index].load(std::memory_order_acquire) == 0) {
+      channel.release_index = (channel.release_index + 1) % num_blocks;
+    }
+    free_index = channel.release_index;
+  }
+
+  u_long destination = channel.phys_addr + (free_index * m_block_size) - (m_margin_blocks * m_block_size);
+  if (destination < channel.phys_addr) {
+    destination += m_dma_memory_size;
+  }
+  if (destination != channel.destination) {
+    channel.destination = destination;
+    m_dma_source->set_read_pointer(channel.dma_id, channel.destination);
+  }
+}
+
+void
+CardWrapper::update_stats(DMAChannel& channel, uint64_t fill_bytes, std::size_t num_blocks, bool wrapped) // NOLINT
+{
+  // Single writer (the DMA processor of the channel): relaxed updates are enough.
+  auto& stats = channel.stats;
+  stats.window_ctr.fetch_add(1, std::memory_order_relaxed);
+  stats.block_ctr.fetch_add(num_blocks, std::memory_order_relaxed);
+  if (num_blocks > stats.max_blocks_per_window.load(std::memory_order_relaxed)) {
+    stats.max_blocks_per_window.store(num_blocks, std::memory_order_relaxed);
+  }
+  if (wrapped) {
+    stats.wraparound_ctr.fetch_add(1, std::memory_order_relaxed);
+  }
+  stats.fill_bytes.store(fill_bytes, std::memory_order_relaxed);
+  if (fill_bytes > stats.max_fill_bytes.load(std::memory_order_relaxed)) {
+    stats.max_fill_bytes.store(fill_bytes, std::memory_order_relaxed);
+  }
+  auto bin = std::min(fill_bytes * stats::DMAStats::num_fill_bins / m_dma_memory_size, stats::DMAStats::num_fill_bins - 1);
+  stats.fill_histogram[bin].fetch_add(1, std::memory_order_relaxed);
+}
+
+void
+CardWrapper::generate_opmon_data()
+{
+  // The node is registered at init: the channels only exist once configured
+  if (!m_configured.load(std::memory_order_acquire)) {
+    return;
+  }
+  for (auto& channel : m_dma_channels) {
+    auto& stats = channel->stats;
+    opmon::DMAInfo info;
+    info.set_num_windows(stats.window_ctr.exchange(0));
+    info.set_num_blocks(stats.block_ctr.exchange(0));
+    info.set_max_blocks_per_window(stats.max_blocks_per_window.exchange(0));
+    info.set_avg_blocks_per_window(info.num_windows() ? static_cast<double>(info.num_blocks()) / info.num_windows() : 0.);
+    info.set_num_wraparounds(stats.wraparound_ctr.exchange(0));
+
+    info.set_fill_level(100. * stats.fill_bytes.load() / m_dma_memory_size);
+    info.set_fill_level_max(100. * stats.max_fill_bytes.exchange(0) / m_dma_memory_size);
+    info.set_fill_level_bin_0(stats.fill_histogram[0].exchange(0));
+    info.set_fill_level_bin_1(stats.fill_histogram[1].exchange(0));
+    info.set_fill_level_bin_2(stats.fill_histogram[2].exchange(0));
+    info.set_fill_level_bin_3(stats.fill_histogram[3].exchange(0));
+    info.set_fill_level_bin_4(stats.fill_histogram[4].exchange(0));
+    info.set_fill_level_bin_5(stats.fill_histogram[5].exchange(0));
+    info.set_fill_level_bin_6(stats.fill_histogram[6].exchange(0));
+    info.set_fill_level_bin_7(stats.fill_histogram[7].exchange(0));
+
+    uint64_t wait_ns = stats.wait_ns.exchange(0);       // NOLINT(build/unsigned)
+    uint64_t processing_ns = stats.processing_ns.exchange(0); // NOLINT(build/unsigned)
+    info.set_time_waiting_us(wait_ns / 1000);
+    info.set_time_processing_us(processing_ns / 1000);
+    info.set_fraction_waiting((wait_ns + processing_ns) ? static_cast<double>(wait_ns) / (wait_ns + processing_ns) : 0.);
+
+    TLOG_DEBUG(TLVL_BOOKKEEPING) << channel->name << " DMA stats ->"
+                                 << " Windows: " << info.num_windows() << " Blocks: " << info.num_blocks()
+                                 << " Fill level: " << info.fill_level() << "% (max " << info.fill_level_max() << "%)"
+                                 << " Wrap-arounds: " << info.num_wraparounds()
+                                 << " Waiting: " << info.fraction_waiting() * 100. << "%";
+
+    publish(std::move(info),
+            { { "card", std::to_string(m_card_id) },
+              { "logical_unit", std::to_string(m_logical_unit) },
+              { "dma", std::to_string(channel->dma_id) } });
+  }
+}
+
+void
+CardWrapper::run_DMA_processor(DMAChannel* channel)
+{
+  TLOG_DEBUG(TLVL_WORK_STEPS) << "CardWrapper starts processing blocks of DMA " << std::to_string(channel->dma_id)
+                              << "...";
+  pin_current_thread(m_dma_cpus, channel->name);
+  process_DMA(*channel);
+  {
+    std::lock_guard<std::mutex> lk(m_processors_mutex);
+    --m_active_processors;
+  }
+  m_processors_cv.notify_all();
+}
+
+void
+CardWrapper::process_DMA(DMAChannel& ch)
+{
+  auto t_wait = std::chrono::steady_clock::now();
   while (m_run_marker.load()) {
 
     // First fix us poll until read address makes sense
-    while ((m_current_addr < m_phys_addr) || (m_phys_addr + m_dma_memory_size < m_current_addr)) {
+    while ((ch.current_addr < ch.phys_addr) || (ch.phys_addr + m_dma_memory_size < ch.current_addr)) {
       if (m_run_marker.load()) {
-        read_current_address();
-        std::this_thread::sleep_for(std::chrono::microseconds(5000)); // fix 5ms initial poll
+        read_current_address(ch);
+        ch.dma_waiter.wait(0, m_block_threshold * m_block_size);
       } else {
         TLOG_DEBUG(TLVL_WORK_STEPS) << "Stop issued during poll! Returning...";
         return;
@@ -295,20 +479,18 @@ CardWrapper::process_DMA()
     }
 
     // Loop or wait for interrupt while there are not enough data
-    while (bytes_available() < m_block_threshold * m_block_size) {
+    while (bytes_available(ch) < m_block_threshold * m_block_size) {
       if (m_run_marker.load()) {
-        if (m_interrupt_mode) {
-          m_card_mutex.lock();
-#if REGMAP_VERSION < 0x500
-          m_flx_card->irq_wait(IRQ_DATA_AVAILABLE);
-#else
-          m_flx_card->irq_wait(IRQ_DATA_AVAILABLE + m_dma_id);
-#endif // REGMAP_VERSION
-          m_card_mutex.unlock();
+        if (m_release_tracking && ch.release_index != ch.read_index) {
+          // The card may be held back by blocks still in use: don't wait for interrupts, give released blocks back
+          update_read_pointer(ch);
+          ch.dma_waiter.wait(bytes_available(ch), m_block_threshold * m_block_size);
+        } else if (m_interrupt_mode) {
+          m_dma_source->wait_for_data(ch.dma_id);
         } else { // poll mode
-          std::this_thread::sleep_for(std::chrono::microseconds(m_poll_time));
+          ch.dma_waiter.wait(bytes_available(ch), m_block_threshold * m_block_size);
         }
-        read_current_address();
+        read_current_address(ch);
       } else {
         TLOG_DEBUG(TLVL_WORK_STEPS) << "Stop issued during waiting for data! Returning...";
         return;
@@ -316,10 +498,38 @@ CardWrapper::process_DMA()
     }
 
     // Set write index and start DMA advancing
-    u_long write_index = (m_current_addr - m_phys_addr) / m_block_size;
+    auto t_process = std::chrono::steady_clock::now();
+    u_long write_index = (ch.current_addr - ch.phys_addr) / m_block_size;
+    // The ring is occupied from the card's read pointer up to the write position
+    uint64_t fill_bytes = (ch.current_addr - ch.destination + m_dma_memory_size) % m_dma_memory_size; // NOLINT
+    bool wrapped = write_index < ch.read_index;
     uint64_t bytes = 0; // NOLINT
-    while (m_read_index != write_index) {
-      uint64_t from_address = m_virt_addr + (m_read_index * m_block_size); // NOLINT
+    if (m_release_tracking) {
+      if (wrapped) {
+        acquire_blocks(ch, ch.read_index, m_dma_memory_size / m_block_size);
+        acquire_blocks(ch, 0, write_index);
+      } else {
+        acquire_blocks(ch, ch.read_index, write_index);
+      }
+    }
+    if (m_block_batch_handler_available) {
+      uint64_t window_ns = std::chrono::nanoseconds(t_process.time_since_epoch()).count(); // NOLINT(build/unsigned)
+      // Wrap-around: deliver the tail of the buffer first
+      if (write_index < ch.read_index) {
+        std::size_t num_blocks = m_dma_memory_size / m_block_size - ch.read_index;
+        m_handle_block_batch(ch.virt_addr + (ch.read_index * m_block_size), num_blocks, window_ns, ch.index);
+        bytes += num_blocks * m_block_size;
+        ch.read_index = 0;
+      }
+      if (ch.read_index != write_index) {
+        std::size_t num_blocks = write_index - ch.read_index;
+        m_handle_block_batch(ch.virt_addr + (ch.read_index * m_block_size), num_blocks, window_ns, ch.index);
+        bytes += num_blocks * m_block_size;
+        ch.read_index = write_index;
+      }
+    }
+    while (ch.read_index != write_index) {
+      uint64_t from_address = ch.virt_addr + (ch.read_index * m_block_size); // NOLINT
 
       // Handle block address
       if (m_block_addr_handler_available) {
@@ -327,20 +537,20 @@ CardWrapper::process_DMA()
       }
 
       // Advance
-      m_read_index = (m_read_index + 1) % (m_dma_memory_size / m_block_size);
+      ch.read_index = (ch.read_index + 1) % (m_dma_memory_size / m_block_size);
       bytes += m_block_size;
     }
 
-    // here check if we can move the read pointer in the circular buffer
-    m_destination = m_phys_addr + (write_index * m_block_size) - (m_margin_blocks * m_block_size);
-    if (m_destination < m_phys_addr) {
-      m_destination += m_dma_memory_size;
-    }
+    ch.dma_waiter.observe(bytes);
+
+    // Finally, move the read pointer in the circular buffer
+    update_read_pointer(ch);
 
-    // Finally, set new pointer
-    m_card_mutex.lock();
-    m_flx_card->dma_set_ptr(m_dma_id, m_destination);
-    m_card_mutex.unlock();
+    auto t_done = std::chrono::steady_clock::now();
+    ch.stats.wait_ns.fetch_add(std::chrono::nanoseconds(t_process - t_wait).count(), std::memory_order_relaxed);
+    ch.stats.processing_ns.fetch_add(std::chrono::nanoseconds(t_done - t_process).count(), std::memory_order_relaxed);
+    update_stats(ch, fill_bytes, bytes / m_block_size, wrapped);
+    t_wait = t_done;
   }
   TLOG_DEBUG(TLVL_WORK_STEPS) << "CardWrapper processor thread finished.";
 }
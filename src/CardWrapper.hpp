@@ -11,7 +11,12 @@
 //#include "flxlibs/felixcardreader/Nljs.hpp"
 //#include "flxlibs/felixcardreader/Structs.hpp"
 
+#include "DMASource.hpp"
+#include "FelixStatistics.hpp"
+#include "WaitStrategy.hpp"
+
 #include "appmodel/FelixInterface.hpp"
+#include "opmonlib/MonitorableObject.hpp"
 #include "utilities/ReusableThread.hpp"
 
 #include "flxcard/FlxCard.h"
@@ -19,21 +24,40 @@
 
 #include <nlohmann/json.hpp>
 
+#include <array>
 #include <atomic>
+#include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 
 namespace dunedaq::flxlibs {
 
-class CardWrapper
+class CardWrapper : public opmonlib::MonitorableObject
 {
 public:
+  // DMA settings of a card, as read from its FelixInterface
+  struct Settings
+  {
+    uint8_t card_id{ 0 };      // NOLINT
+    uint8_t logical_unit{ 0 }; // NOLINT
+    uint8_t dma_id{ 0 };       // NOLINT
+    std::size_t margin_blocks{ 4 };
+    std::size_t block_threshold{ 10 };
+    bool interrupt_mode{ false };
+    std::size_t poll_time{ 5000 }; // us
+    uint8_t numa_id{ 0 };          // NOLINT
+    std::size_t dma_memory_size{ 1024 * 1024 * 1024UL }; // per DMA descriptor
+  };
+
   /**
    * @brief CardWrapper Constructor
    * @param name Instance name for this CardWrapper instance
    */
   CardWrapper(const appmodel::FelixInterface * cfg, std::vector<unsigned int>);
+  // Without a configuration database, e.g.: on an EmulatedDMASource
+  CardWrapper(const Settings& settings, std::vector<unsigned int> enabled_links);
   ~CardWrapper();
   CardWrapper(const CardWrapper&) = delete;            ///< CardWrapper is not copy-constructible
   CardWrapper& operator=(const CardWrapper&) = delete; ///< CardWrapper is not copy-assignable
@@ -53,6 +77,51 @@ public:
     m_block_addr_handler_available = true;
   }
 
+  // Block addresses of a DMA window are delivered as contiguous ranges of num_blocks blocks, get_block_size() apart.
+  // A window that wraps around the circular buffer is delivered in two calls. Takes precedence over the
+  // per block handler. The third argument is the time the window was observed, in steady clock nanoseconds, the
+  // last one the position of the DMA descriptor in the configured ids, below get_num_dma_channels().
+  void set_block_batch_handler(std::function<void(uint64_t, std::size_t, uint64_t, std::size_t)>& handle) // NOLINT
+  {
+    m_handle_block_batch = handle;
+    m_block_batch_handler_available = true;
+  }
+
+  static constexpr std::size_t get_block_size() { return m_block_size; }
+  std::size_t get_num_dma_channels() const { return m_dma_ids.size(); }
+
+  // How the DMA processor waits for new data. Defaults to interrupts in interrupt mode, and to a fixed sleep of
+  // the configured poll time otherwise. Only allowed before configure.
+  void set_wait_strategy(WaitStrategy strategy, std::size_t spin_count = 1000);
+
+  // Serve several to-host DMA descriptors, each with its own CMEM ring on the given NUMA node (defaults to the
+  // configured one) and its own processor thread. All of them feed the same block handlers: the firmware
+  // routes each link to a single descriptor, so the blocks of an elink keep coming from a single thread.
+  // Only allowed before configure.
+  void set_dma_ids(const std::vector<uint8_t>& dma_ids, const std::vector<uint8_t>& numa_ids = {}); // NOLINT
+
+  // CPU set of the DMA processor threads, validated against the NUMA node of their DMA memory at configure.
+  void set_dma_cpu_affinity(const std::vector<int>& cpus) { m_dma_cpus = cpus; }
+
+  // With release tracking, the read pointer of the card only advances past blocks that were released with
+  // release_block, instead of following the delivered blocks at m_margin_blocks distance. Consumers can then
+  // keep referencing DMA memory until they release it. Only allowed before configure.
+  void set_block_release_tracking(bool enable);
+
+  // Marks a delivered block as no longer referenced. Called by the consumers, from any thread, in constant time.
+  void release_block(uint64_t block_addr); // NOLINT(build/unsigned)
+
+  // Keep the DMA configuration across stop/start: stop only stops the DMA descriptors, without resetting the card.
+  // The rings are rewound by start either way. The CMEM rings are always kept until destruction.
+  void set_fast_restart(bool fast_restart) { m_fast_restart = fast_restart; }
+
+  // Replace the FlxCard backed DMA source (e.g.: with an EmulatedDMASource). Only allowed before configure.
+  void set_dma_source(std::unique_ptr<DMASource> dma_source);
+
+protected:
+  // Ring occupancy, wrap-arounds, window sizes and wait/processing times of every DMA descriptor
+  void generate_opmon_data() override;
+
 private:
   
   // Constants
@@ -60,7 +129,32 @@ private:
   // static constexpr size_t m_margin_blocks = 4;
   // static constexpr size_t m_block_threshold = 256;
   static constexpr size_t m_block_size = 4096; // felix::packetformat::BLOCKSIZE;
-  static constexpr size_t m_dma_wraparound = FLX_DMA_WRAPAROUND;
+
+  // Per DMA descriptor: CMEM ring, read pointer and processor
+  struct DMAChannel
+  {
+    DMAChannel(std::size_t idx, uint8_t id, uint8_t numa) // NOLINT
+      : index(idx)
+      , dma_id(id)
+      , numa_id(numa)
+      , dma_processor(0)
+    {}
+    std::size_t index;         // position in the configured DMA ids
+    uint8_t dma_id;            // NOLINT
+    uint8_t numa_id;           // NOLINT
+    std::string name;
+    int cmem_handle{ 0 };      // handle to the DMA memory block
+    uint64_t virt_addr{ 0 };   // NOLINT virtual address of the DMA memory block
+    uint64_t phys_addr{ 0 };   // NOLINT physical address of the DMA memory block
+    uint64_t current_addr{ 0 }; // NOLINT pointer to the current write position for the card
+    unsigned read_index{ 0 };  // NOLINT
+    unsigned release_index{ 0 }; // NOLINT oldest block still referenced by a consumer (release tracking)
+    std::unique_ptr<std::atomic<uint8_t>[]> block_in_use; // NOLINT one flag per block (release tracking)
+    u_long destination{ 0 };   // u_long -> FlxCard.h
+    Waiter dma_waiter;
+    utilities::ReusableThread dma_processor;
+    stats::DMAStats stats;
+  };
 
   // Card
   void open_card();
@@ -69,19 +163,24 @@ private:
   // DMA
   int allocate_CMEM(uint8_t numa, u_long bsize, u_long* paddr, u_long* vaddr); // NOLINT
   void init_DMA();
+  void rewind_DMA(); // clears the release flags: only while no consumer holds blocks, i.e.: at start
   void start_DMA();
   void stop_DMA();
-  uint64_t bytes_available(); // NOLINT
-  void read_current_address();
+  uint64_t bytes_available(const DMAChannel& channel); // NOLINT
+  void read_current_address(DMAChannel& channel);
+  void acquire_blocks(DMAChannel& channel, unsigned first_index, unsigned end_index);
+  void update_read_pointer(DMAChannel& channel);
+  void update_stats(DMAChannel& channel, uint64_t fill_bytes, std::size_t num_blocks, bool wrapped); // NOLINT
 
   // Configuration and internals
   
   std::atomic<bool> m_run_marker;
-  bool m_configured{ false };
+  std::atomic<bool> m_configured{ false }; // released once m_dma_channels is filled, it never changes after
   uint8_t m_card_id;      // NOLINT
   uint8_t m_logical_unit; // NOLINT
   std::string m_card_id_str;
-  uint8_t m_dma_id;         // NOLINT
+  std::vector<uint8_t> m_dma_ids;  // NOLINT
+  std::vector<uint8_t> m_numa_ids; // NOLINT
   size_t m_margin_blocks;   // NOLINT
   size_t m_block_threshold; // NOLINT
   bool m_interrupt_mode;    // NOLINT
@@ -89,28 +188,34 @@ private:
   uint8_t m_numa_id;        // NOLINT
   std::vector<unsigned int> m_links_enabled;      // NOLINT
   std::string m_info_str;
+  WaitStrategy m_wait_strategy;
+  std::size_t m_spin_count{ 0 };
+  std::vector<int> m_dma_cpus;
+  bool m_release_tracking{ false };
+  bool m_fast_restart{ false };
 
-  // Card object
-  using UniqueFlxCard = std::unique_ptr<FlxCard>;
-  UniqueFlxCard m_flx_card;
-  std::mutex m_card_mutex;
+  // DMA source: FlxCard or emulation
+  std::unique_ptr<DMASource> m_dma_source;
 
   // DMA: CMEM
-  std::size_t m_dma_memory_size; // size of CMEM (driver) memory to allocate
-  int m_cmem_handle;             // handle to the DMA memory block
-  uint64_t m_virt_addr;          // NOLINT virtual address of the DMA memory block
-  uint64_t m_phys_addr;          // NOLINT physical address of the DMA memory block
-  uint64_t m_current_addr;       // NOLINT pointer to the current write position for the card
-  unsigned m_read_index;         // NOLINT
-  u_long m_destination;          // u_long -> FlxCard.h
+  std::size_t m_dma_memory_size; // size of CMEM (driver) memory to allocate, per DMA descriptor
+  std::vector<std::unique_ptr<DMAChannel>> m_dma_channels;
+  // Rings overlapping each m_dma_memory_size sized slot of the address space, for release_block. A ring spans at
+  // most two slots, and a slot overlaps at most two rings. Filled at configure, read only after.
+  std::unordered_map<uint64_t, std::array<DMAChannel*, 2>> m_release_slots; // NOLINT(build/unsigned)
 
   // Processor
   inline static const std::string m_dma_processor_name = "flx-dma";
   std::atomic<bool> m_run_lock;
-  utilities::ReusableThread m_dma_processor;
   std::function<void(uint64_t)> m_handle_block_addr; // NOLINT
   bool m_block_addr_handler_available{ false };
-  void process_DMA();
+  std::function<void(uint64_t, std::size_t, uint64_t, std::size_t)> m_handle_block_batch; // NOLINT
+  bool m_block_batch_handler_available{ false };
+  std::mutex m_processors_mutex;
+  std::condition_variable m_processors_cv;
+  std::size_t m_active_processors{ 0 };
+  void run_DMA_processor(DMAChannel* channel);
+  void process_DMA(DMAChannel& channel);
 };
 
 } // namespace dunedaq::flxlibs
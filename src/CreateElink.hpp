@@ -9,27 +9,74 @@
 #define FLXLIBS_SRC_CREATEELINK_HPP_
 
 #include "ElinkConcept.hpp"
-#include "ElinkModel.hpp"
+#include "ElinkModelRegistry.hpp"
 #include "flxlibs/AvailableParserOperations.hpp"
+#include "flxlibs/VariableSizePooledPayload.hpp"
 #include "datahandlinglibs/DataHandlingIssues.hpp"
-//#include "fdreadoutlibs/ProtoWIBSuperChunkTypeAdapter.hpp"
-//#include "fdreadoutlibs/DUNEWIBSuperChunkTypeAdapter.hpp"
 #include "fdreadoutlibs/DAPHNESuperChunkTypeAdapter.hpp"
 #include "fdreadoutlibs/DAPHNEStreamSuperChunkTypeAdapter.hpp"
 #include "fdreadoutlibs/VariableSizePayloadTypeAdapter.hpp"
 
+// The WIB superchunk adapters are only shipped by the fdreadoutlibs versions before the WIBEth readout. Without them
+// the WIBFrame and WIB2Frame data types are not registered, see the payload types logged by FelixReaderModule::init.
+#if __has_include("fdreadoutlibs/ProtoWIBSuperChunkTypeAdapter.hpp")
+#include "fdreadoutlibs/ProtoWIBSuperChunkTypeAdapter.hpp"
+#define FLXLIBS_HAVE_PROTOWIB_SUPERCHUNK
+#endif
+#if __has_include("fdreadoutlibs/DUNEWIBSuperChunkTypeAdapter.hpp")
+#include "fdreadoutlibs/DUNEWIBSuperChunkTypeAdapter.hpp"
+#define FLXLIBS_HAVE_DUNEWIB_SUPERCHUNK
+#endif
+
 #include <memory>
 #include <string>
 
 namespace dunedaq {
 
-//DUNE_DAQ_TYPESTRING(dunedaq::fdreadoutlibs::types::ProtoWIBSuperChunkTypeAdapter, "WIBFrame")
-//DUNE_DAQ_TYPESTRING(dunedaq::fdreadoutlibs::types::DUNEWIBSuperChunkTypeAdapter, "WIB2Frame")
+namespace flxlibs::types {
+// Payloads sent as handles of the ObjectPool of their elink, see FixsizedHeapPolicy
+using DAPHNESuperChunkHandle = ObjectPool<fdreadoutlibs::types::DAPHNESuperChunkTypeAdapter>::Handle;
+using DAPHNEStreamSuperChunkHandle = ObjectPool<fdreadoutlibs::types::DAPHNEStreamSuperChunkTypeAdapter>::Handle;
+} // namespace flxlibs::types
+
+#ifdef FLXLIBS_HAVE_PROTOWIB_SUPERCHUNK
+DUNE_DAQ_TYPESTRING(dunedaq::fdreadoutlibs::types::ProtoWIBSuperChunkTypeAdapter, "WIBFrame")
+#endif
+#ifdef FLXLIBS_HAVE_DUNEWIB_SUPERCHUNK
+DUNE_DAQ_TYPESTRING(dunedaq::fdreadoutlibs::types::DUNEWIBSuperChunkTypeAdapter, "WIB2Frame")
+#endif
 DUNE_DAQ_TYPESTRING(dunedaq::fdreadoutlibs::types::DAPHNESuperChunkTypeAdapter, "PDSFrame")
 DUNE_DAQ_TYPESTRING(dunedaq::fdreadoutlibs::types::DAPHNEStreamSuperChunkTypeAdapter, "PDSStreamFrame")
+DUNE_DAQ_TYPESTRING(dunedaq::flxlibs::types::VariableSizePooledPayload, "VariableSizePooledPayload")
+DUNE_DAQ_TYPESTRING(dunedaq::flxlibs::types::DAPHNESuperChunkHandle, "PDSFrameHandle")
+DUNE_DAQ_TYPESTRING(dunedaq::flxlibs::types::DAPHNEStreamSuperChunkHandle, "PDSStreamFrameHandle")
 
 namespace flxlibs {
 
+// Payload types with an ElinkModel. Register new formats here, or next to their type string.
+#ifdef FLXLIBS_HAVE_PROTOWIB_SUPERCHUNK
+inline const ElinkModelRegistrar<fdreadoutlibs::types::ProtoWIBSuperChunkTypeAdapter, parsers::FixsizedChunkPolicy>
+  register_wib_frame;
+#endif
+#ifdef FLXLIBS_HAVE_DUNEWIB_SUPERCHUNK
+inline const ElinkModelRegistrar<fdreadoutlibs::types::DUNEWIBSuperChunkTypeAdapter, parsers::FixsizedChunkPolicy>
+  register_wib2_frame;
+#endif
+inline const ElinkModelRegistrar<fdreadoutlibs::types::DAPHNEStreamSuperChunkTypeAdapter, parsers::FixsizedChunkPolicy>
+  register_pds_stream_frame;
+inline const ElinkModelRegistrar<fdreadoutlibs::types::DAPHNESuperChunkTypeAdapter, parsers::FixsizedChunkPolicy>
+  register_pds_frame;
+// Variable sized user payloads
+inline const ElinkModelRegistrar<fdreadoutlibs::types::VariableSizePayloadTypeAdapter, parsers::VarsizedWrapperPolicy>
+  register_varsize("varsize");
+inline const ElinkModelRegistrar<types::VariableSizePooledPayload, parsers::VarsizedPooledPolicy>
+  register_varsize_pooled;
+// Fixed size payloads sent as handles of a pool
+inline const ElinkModelRegistrar<types::DAPHNEStreamSuperChunkHandle, parsers::FixsizedHeapPolicy>
+  register_pds_stream_frame_handle;
+inline const ElinkModelRegistrar<types::DAPHNESuperChunkHandle, parsers::FixsizedHeapPolicy>
+  register_pds_frame_handle;
+
 std::unique_ptr<ElinkConcept>
 createElinkModel(const std::string& conn_uid)
 {
@@ -41,72 +88,13 @@ createElinkModel(const std::string& conn_uid)
   std::string raw_dt{ *datatypes.begin() };
   TLOG() << "Choosing specializations for ElinkModel for output connection "
          << " [uid:" << conn_uid << " , data_type:" << raw_dt << ']';
-/*
-
-  if (raw_dt.find("WIBFrame") != std::string::npos) {
-    // WIB1 specific char arrays
-    // Create Model
-    auto elink_model = std::make_unique<ElinkModel<fdreadoutlibs::types::ProtoWIBSuperChunkTypeAdapter>>();
-
-    // Setup sink (acquire pointer from QueueRegistry)
-    elink_model->set_sink(conn_uid);
-
-    // Get parser and sink
-    auto& parser = elink_model->get_parser();
-    auto& sink = elink_model->get_sink();
-    auto& error_sink = elink_model->get_error_sink();
-
-    // Modify parser as needed...
-    parser.process_chunk_func = parsers::fixsizedChunkInto<fdreadoutlibs::types::ProtoWIBSuperChunkTypeAdapter>(sink);
-    if (error_sink != nullptr) {
-      parser.process_chunk_with_error_func = parsers::errorChunkIntoSink(error_sink);
-    }
-    // parser.process_block_func = ...
-
-    // Return with setup model
-    return elink_model;
 
-  } else if (raw_dt.find("WIB2Frame") != std::string::npos) {
-    // WIB2 specific char arrays
-    auto elink_model = std::make_unique<ElinkModel<fdreadoutlibs::types::DUNEWIBSuperChunkTypeAdapter>>();
-    elink_model->set_sink(conn_uid);
-    auto& parser = elink_model->get_parser();
-    auto& sink = elink_model->get_sink();
-    parser.process_chunk_func = parsers::fixsizedChunkInto<fdreadoutlibs::types::DUNEWIBSuperChunkTypeAdapter>(sink);
-    return elink_model;
-
-  } else*/ 
-  if (raw_dt.find("PDSStreamFrame") != std::string::npos) {
-    // PDS specific char arrays
-    auto elink_model = std::make_unique<ElinkModel<fdreadoutlibs::types::DAPHNEStreamSuperChunkTypeAdapter>>();
-    elink_model->set_sink(conn_uid);
-    auto& parser = elink_model->get_parser();
-    auto& sink = elink_model->get_sink();
-    parser.process_chunk_func = parsers::fixsizedChunkInto<fdreadoutlibs::types::DAPHNEStreamSuperChunkTypeAdapter>(sink);
-    return elink_model;
-
-  } else if (raw_dt.find("PDSFrame") != std::string::npos) {
-    // PDS specific char arrays
-    auto elink_model = std::make_unique<ElinkModel<fdreadoutlibs::types::DAPHNESuperChunkTypeAdapter>>();
-    elink_model->set_sink(conn_uid);
-    auto& parser = elink_model->get_parser();
-    auto& sink = elink_model->get_sink();
-    parser.process_chunk_func = parsers::fixsizedChunkInto<fdreadoutlibs::types::DAPHNESuperChunkTypeAdapter>(sink);
-    return elink_model;
-
-
-  } else if (raw_dt.find("varsize") != std::string::npos) {
-    // Variable sized user payloads
-    auto elink_model = std::make_unique<ElinkModel<fdreadoutlibs::types::VariableSizePayloadTypeAdapter>>();
-    elink_model->set_sink(conn_uid);
-    auto& parser = elink_model->get_parser();
-    auto& sink = elink_model->get_sink();
-    parser.process_chunk_func = parsers::varsizedChunkIntoWrapper(sink);
-    parser.process_shortchunk_func = parsers::varsizedShortchunkIntoWrapper(sink);
-    return elink_model;
+  auto elink_model = ElinkModelRegistry::get().create(raw_dt, conn_uid);
+  if (!elink_model) {
+    ers::error(dunedaq::datahandlinglibs::GenericConfigurationError(ERS_HERE,
+      "No ElinkModel for data type " + raw_dt + ", the known ones are: " + ElinkModelRegistry::get().get_data_types()));
   }
-
-  return nullptr;
+  return elink_model;
 }
 
 } // namespace flxlibs
@@ -0,0 +1,47 @@
+/**
+ * @file DMASource.hpp Interface of the to-host DMA engine used by CardWrapper.
+ * Implemented by the FlxCard/CMEM backend and by a software emulation.
+ *
+ * This is part of the DUNE DAQ , copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef FLXLIBS_SRC_DMASOURCE_HPP_
+#define FLXLIBS_SRC_DMASOURCE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dunedaq::flxlibs {
+
+class DMASource
+{
+public:
+  DMASource() = default;
+  virtual ~DMASource() = default;
+  DMASource(const DMASource&) = delete;            ///< DMASource is not copy-constructible
+  DMASource& operator=(const DMASource&) = delete; ///< DMASource is not copy-assignable
+  DMASource(DMASource&&) = delete;                 ///< DMASource is not move-constructible
+  DMASource& operator=(DMASource&&) = delete;      ///< DMASource is not move-assignable
+
+  // Device, locking the given DMA descriptors
+  virtual void open_card(const std::vector<uint8_t>& dma_ids) = 0; // NOLINT
+  virtual void close_card() = 0;
+
+  // Allocates the circular buffer the DMA writes into. Returns the handle of the segment.
+  virtual int allocate_buffer(uint8_t numa, std::size_t bsize, uint64_t* paddr, uint64_t* vaddr) = 0; // NOLINT
+
+  // DMA
+  virtual void init_DMA(const std::vector<uint8_t>& dma_ids, bool interrupt_mode) = 0; // NOLINT
+  virtual void start_DMA(uint8_t dma_id, uint64_t paddr, std::size_t bsize) = 0;      // NOLINT
+  virtual void stop_DMA(uint8_t dma_id) = 0;                                          // NOLINT
+  virtual uint64_t read_current_address(uint8_t dma_id) = 0;                          // NOLINT
+  virtual void set_read_pointer(uint8_t dma_id, uint64_t paddr) = 0;                  // NOLINT
+  virtual void wait_for_data(uint8_t dma_id) = 0;                                     // NOLINT
+  virtual void cancel_wait(uint8_t dma_id) = 0;                                       // NOLINT wakes up wait_for_data
+};
+
+} // namespace dunedaq::flxlibs
+
+#endif // FLXLIBS_SRC_DMASOURCE_HPP_
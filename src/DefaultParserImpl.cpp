@@ -43,36 +43,60 @@ DefaultParserImpl::get_stats()
 void
 DefaultParserImpl::chunk_processed(const felix::packetformat::chunk& chunk)
 {
-  process_chunk_func(chunk);
-  m_stats.chunk_ctr++;
+  uint64_t t_sink = m_sink_latency != nullptr ? stats::steady_clock_ns() : 0; // NOLINT(build/unsigned)
+  if (!process_chunk_func(chunk)) {
+    m_counters.dropped_payload_ctr++;
+  }
+  if (m_sink_latency != nullptr) {
+    m_sink_latency->record(stats::steady_clock_ns() - t_sink);
+  }
+  m_counters.chunk_ctr++;
+  if (m_detailed_stats) {
+    stats::count_chunk_size(m_counters, chunk.length());
+  }
+  end_chunk();
 }
 
 void
 DefaultParserImpl::shortchunk_processed(const felix::packetformat::shortchunk& shortchunk)
 {
-  process_shortchunk_func(shortchunk);
-  m_stats.short_ctr++;
+  uint64_t t_sink = m_sink_latency != nullptr ? stats::steady_clock_ns() : 0; // NOLINT(build/unsigned)
+  if (!process_shortchunk_func(shortchunk)) {
+    m_counters.dropped_payload_ctr++;
+  }
+  if (m_sink_latency != nullptr) {
+    m_sink_latency->record(stats::steady_clock_ns() - t_sink);
+  }
+  m_counters.short_ctr++;
+  if (m_detailed_stats) {
+    stats::count_chunk_size(m_counters, shortchunk.length);
+  }
+  end_chunk();
 }
 
 void
 DefaultParserImpl::subchunk_processed(const felix::packetformat::subchunk& subchunk)
 {
   process_subchunk_func(subchunk);
-  m_stats.subchunk_ctr++;
+  m_counters.subchunk_ctr++;
+  m_open_chunk = true;
 }
 
 void
 DefaultParserImpl::block_processed(const felix::packetformat::block& block)
 {
   process_block_func(block);
-  m_stats.block_ctr++;
+  m_counters.block_ctr++;
 }
 
 void
 DefaultParserImpl::chunk_processed_with_error(const felix::packetformat::chunk& chunk)
 {
-  process_chunk_with_error_func(chunk);
-  m_stats.error_chunk_ctr++;
+  if (!process_chunk_with_error_func(chunk)) {
+    m_counters.dropped_payload_ctr++;
+  }
+  m_counters.error_chunk_ctr++;
+  end_chunk();
 }
 
 void
@@ -80,29 +104,31 @@ DefaultParserImpl::subchunk_processed_with_error(const felix::packetformat::subc
 {
   process_subchunk_with_error_func(subchunk);
   if (subchunk.crcerr_flag) {   // NOLINT(runtime/output_format)
-    m_stats.subchunk_crc_error_ctr++;
+    m_counters.subchunk_crc_error_ctr++;
   }
   if (subchunk.trunc_flag) {
-    m_stats.subchunk_trunc_error_ctr++;
+    m_counters.subchunk_trunc_error_ctr++;
   }
   if (subchunk.err_flag) {
-    m_stats.subchunk_error_ctr++;
+    m_counters.subchunk_error_ctr++;
   }
-  m_stats.error_subchunk_ctr++;
+  m_counters.error_subchunk_ctr++;
+  m_open_chunk = true;
 }
 
 void
 DefaultParserImpl::shortchunk_process_with_error(const felix::packetformat::shortchunk& shortchunk)
 {
   process_shortchunk_with_error_func(shortchunk);
-  m_stats.error_short_ctr++;
+  m_counters.error_short_ctr++;
+  end_chunk();
 }
 
 void
 DefaultParserImpl::block_processed_with_error(const felix::packetformat::block& block)
 {
   process_block_with_error_func(block);
-  m_stats.error_block_ctr++;
+  m_counters.error_block_ctr++;
 }
 
 } // namespace flxlibs
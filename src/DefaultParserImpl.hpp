@@ -32,14 +32,34 @@ public:
   DefaultParserImpl(DefaultParserImpl&&) = delete;                 ///< DefaultParserImpl is not move-constructible
   DefaultParserImpl& operator=(DefaultParserImpl&&) = delete;      ///< DefaultParserImpl is not move-assignable
 
+  // The chunk operations bound at run time allocate their payloads themselves, see StaticParserImpl
+  using payload_pool_t = void;
+  static constexpr bool uses_payload_pool = false;
+
   stats::ParserStats& get_stats();
 
-  // Public functions for re-bind
-  std::function<void(const felix::packetformat::chunk& chunk)> process_chunk_func;
-  std::function<void(const felix::packetformat::shortchunk& shortchunk)> process_shortchunk_func;
+  // The callbacks count into thread local counters: publish them to the stats, e.g.: once per batch of blocks.
+  void publish_stats() { stats::publish(m_counters, m_stats); }
+
+  // Also count the bytes and the size distribution of the chunks
+  void set_detailed_stats(bool detailed_stats) { m_detailed_stats = detailed_stats; }
+
+  // Histogram of the time spent in the chunk functions, nullptr to not measure it
+  void set_sink_latency(stats::LatencyHistogram* sink_latency) { m_sink_latency = sink_latency; }
+
+  // Number of chunks that ended, delivered or not, and whether the BlockParser is assembling one: it then holds
+  // pointers into the blocks since the one the chunk started in.
+  uint64_t get_chunk_boundaries() const { return m_chunk_boundaries; } // NOLINT(build/unsigned)
+  bool has_open_chunk() const { return m_open_chunk; }
+  // The open chunk is given up on, with the BlockParser that was assembling it
+  void discard_open_chunk() { end_chunk(); }
+
+  // Public functions for re-bind. The chunk ones return false for a payload they dropped, e.g.: on a full sink.
+  std::function<bool(const felix::packetformat::chunk& chunk)> process_chunk_func;
+  std::function<bool(const felix::packetformat::shortchunk& shortchunk)> process_shortchunk_func;
   std::function<void(const felix::packetformat::subchunk& subchunk)> process_subchunk_func;
   std::function<void(const felix::packetformat::block& block)> process_block_func;
-  std::function<void(const felix::packetformat::chunk& chunk)> process_chunk_with_error_func;
+  std::function<bool(const felix::packetformat::chunk& chunk)> process_chunk_with_error_func;
   std::function<void(const felix::packetformat::subchunk& subchunk)> process_subchunk_with_error_func;
   std::function<void(const felix::packetformat::shortchunk& shortchunk)> process_shortchunk_with_error_func;
   std::function<void(const felix::packetformat::block& block)> process_block_with_error_func;
@@ -56,16 +76,29 @@ public:
 
 private:
   // Default/empty implementations: No-op "processing"
-  void process_chunk(const felix::packetformat::chunk& /*chunk*/) {}
-  void process_shortchunk(const felix::packetformat::shortchunk& /*shortchunk*/) {}
+  bool process_chunk(const felix::packetformat::chunk& /*chunk*/) { return true; }
+  bool process_shortchunk(const felix::packetformat::shortchunk& /*shortchunk*/) { return true; }
   void process_subchunk(const felix::packetformat::subchunk& /*subchunk*/) {}
   void process_block(const felix::packetformat::block& /*block*/) {}
-  void process_chunk_with_error(const felix::packetformat::chunk& /*chunk*/) {}
+  bool process_chunk_with_error(const felix::packetformat::chunk& /*chunk*/) { return true; }
   void process_subchunk_with_error(const felix::packetformat::subchunk& /*subchunk*/) {}
   void process_shortchunk_with_error(const felix::packetformat::shortchunk& /*shortchunk*/) {}
   void process_block_with_error(const felix::packetformat::block& /*block*/) {}
 
+  void end_chunk()
+  {
+    ++m_chunk_boundaries;
+    m_open_chunk = false;
+  }
+
+  // Chunk boundaries
+  uint64_t m_chunk_boundaries{ 0 }; // NOLINT(build/unsigned)
+  bool m_open_chunk{ false };
+
   // Statistics
+  bool m_detailed_stats{ false };
+  stats::LatencyHistogram* m_sink_latency{ nullptr };
+  stats::ParserCounters m_counters;
   stats::ParserStats m_stats;
 };
 
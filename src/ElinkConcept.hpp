@@ -10,33 +10,47 @@
 #ifndef FLXLIBS_SRC_ELINKCONCEPT_HPP_
 #define FLXLIBS_SRC_ELINKCONCEPT_HPP_
 
-#include "DefaultParserImpl.hpp"
+#include "Prefetch.hpp"
+#include "ThreadAffinity.hpp"
 
 #include "appfwk/DAQModule.hpp"
-#include "packetformat/detail/block_parser.hpp"
+#include "packetformat/block_format.hpp"
 
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <vector>
 
 namespace dunedaq {
 namespace flxlibs {
 
+// What the router does with a block whose elink queue is full
+enum class OverflowPolicy
+{
+  kDrop,      // drop the newest block
+  kSpinRetry, // retry for a budget of spins, then drop
+  kStall      // retry until queued, spinning then backing off: holds the DMA processor, hence the read pointer, and
+              // back-pressures the card
+};
+
+class ParserExecutor;
+
 class ElinkConcept : public opmonlib::MonitorableObject 
 {
 public:
   ElinkConcept()
-    : m_parser_impl()
-    , m_card_id(0)
+    : m_card_id(0)
     , m_logical_unit(0)
     , m_link_id(0)
     , m_link_tag(0)
     , m_elink_str("")
     , m_elink_source_tid("")
-  {
-    m_parser = std::make_unique<felix::packetformat::BlockParser<DefaultParserImpl>>(m_parser_impl);
-  }
+  {}
   virtual ~ElinkConcept() {}
 
   ElinkConcept(const ElinkConcept&) = delete;            ///< ElinkConcept is not copy-constructible
@@ -50,9 +64,15 @@ public:
   virtual void start() = 0;
   virtual void stop() = 0;
 
-  virtual bool queue_in_block_address(uint64_t block_addr) = 0; // NOLINT
+  // window_ns is the steady clock time the DMA window of the block was observed at, for the latency histograms
+  virtual bool queue_in_block_address(uint64_t block_addr, uint64_t window_ns = 0) = 0; // NOLINT
 
-  DefaultParserImpl& get_parser() { return std::ref(m_parser_impl); }
+  // Parses up to a batch of queued blocks, returns the number of blocks parsed. Used by a ParserExecutor.
+  virtual std::size_t parse_batch() = 0;
+  virtual bool has_blocks() = 0;
+  // Drops the chunk being assembled and releases its blocks, if no block came for the stale chunk timeout. Called
+  // by the thread parsing the elink while it is idle.
+  virtual void release_stale_chunk() = 0;
 
   void set_ids(int card, int slr, int id, int tag)
   {
@@ -75,17 +95,106 @@ public:
 
   }
 
-protected:
-  // Block Parser
-  DefaultParserImpl m_parser_impl;
-  std::unique_ptr<felix::packetformat::BlockParser<DefaultParserImpl>> m_parser;
+  // CPU set of the parser thread, validated against the NUMA node of the DMA memory.
+  void set_cpu_affinity(const std::vector<int>& cpus, int numa_id)
+  {
+    m_cpus = cpus;
+    validate_cpu_affinity(m_cpus, numa_id, m_elink_str);
+  }
+
+  // Called with the address of every block once it is parsed and no chunk being assembled references it any
+  // more, so the DMA memory can be reused.
+  void set_block_release_handler(std::function<void(uint64_t)> handler) // NOLINT(build/unsigned)
+  {
+    m_release_block = std::move(handler);
+  }
+
+  // With release tracking, a link going quiet in the middle of a chunk would hold its blocks, and the read pointer
+  // of the card behind them, until it sends again. Its chunk is dropped after this time instead, 0 never.
+  void set_stale_chunk_timeout(std::chrono::milliseconds timeout) { m_stale_chunk_timeout = timeout; }
+
+  void set_overflow_policy(OverflowPolicy policy, std::size_t spin_count)
+  {
+    m_overflow_policy = policy;
+    m_overflow_spin_count = spin_count;
+  }
+
+  // Number of polls of an empty block queue before the parser parks until the router queues a block.
+  void set_idle_spin_count(std::size_t spin_count) { m_idle_spin_count = spin_count; }
+
+  // Maximum number of blocks parsed back to back, between run marker checks and stats publications.
+  void set_batch_size(std::size_t batch_size) { m_batch_size = std::max<std::size_t>(batch_size, 1); }
 
+  // Parse on the workers of a shared executor, instead of on an own thread. To be set before start.
+  void set_executor(ParserExecutor* executor, std::size_t home_worker)
+  {
+    m_executor = executor;
+    m_home_worker = home_worker;
+  }
+  std::size_t get_home_worker() const { return m_home_worker; }
+
+  // An elink is scheduled on the executor at most once: its block queue has a single consumer.
+  // The fences pair a queue write followed by try_schedule with unschedule followed by has_blocks.
+  bool try_schedule()
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return !m_scheduled.load(std::memory_order_relaxed) && !m_scheduled.exchange(true, std::memory_order_acq_rel);
+  }
+  void unschedule()
+  {
+    m_scheduled.store(false, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+
+  // Prefetch the next queued block while parsing the current one.
+  void set_prefetch(bool prefetch) { m_prefetch = prefetch; }
+
+  // Histogram the latencies of the blocks from their DMA window to the parser, of parsing, and of sending their
+  // chunks. Costs a few clock reads per block and chunk. Before conf.
+  void set_latency_tracking(bool latency_tracking) { m_latency_tracking = latency_tracking; }
+
+  // Count the bytes and the size distribution of the chunks, at a small cost per chunk. Before conf.
+  void set_detailed_stats(bool detailed_stats) { m_detailed_stats = detailed_stats; }
+
+  // Time a parser waits for room in a full sink before dropping a payload, 0 to drop right away. Before conf.
+  void set_send_timeout(std::chrono::milliseconds timeout) { m_send_timeout = timeout; }
+
+  // Chunks of at least this many bytes are copied with non-temporal stores, 0 never. Before conf.
+  void set_streaming_copy_threshold(std::size_t threshold) { m_streaming_copy_threshold = threshold; }
+
+  // Size of the payload pool, for the payload types allocated from one: objects, or buffers per size class up
+  // to max_payload_size bytes. Before conf.
+  void set_payload_pool(std::size_t capacity, std::size_t max_payload_size)
+  {
+    m_payload_pool_capacity = capacity;
+    m_payload_pool_max_size = max_payload_size;
+  }
+
+protected:
   int m_card_id;
   int m_logical_unit;
   int m_link_id;
   int m_link_tag;
   std::string m_elink_str;
   std::string m_elink_source_tid;
+  std::vector<int> m_cpus;
+  bool m_prefetch{ false };
+  OverflowPolicy m_overflow_policy{ OverflowPolicy::kDrop };
+  std::size_t m_idle_spin_count{ 1000 };
+  std::size_t m_batch_size{ 1 };
+  ParserExecutor* m_executor{ nullptr };
+  std::size_t m_home_worker{ 0 };
+  std::atomic<bool> m_scheduled{ false };
+  std::size_t m_overflow_spin_count{ 0 };
+  std::size_t m_block_size{ felix::packetformat::BLOCKSIZE };
+  bool m_detailed_stats{ false };
+  bool m_latency_tracking{ false };
+  std::chrono::milliseconds m_send_timeout{ 100 };
+  std::size_t m_streaming_copy_threshold{ 0 };
+  std::size_t m_payload_pool_capacity{ 0 };
+  std::size_t m_payload_pool_max_size{ 0 };
+  std::function<void(uint64_t)> m_release_block; // NOLINT(build/unsigned)
+  std::chrono::milliseconds m_stale_chunk_timeout{ 1000 };
   std::chrono::time_point<std::chrono::high_resolution_clock> m_t0;
 
 private:
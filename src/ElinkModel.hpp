@@ -8,11 +8,16 @@
 #ifndef FLXLIBS_SRC_ELINKMODEL_HPP_
 #define FLXLIBS_SRC_ELINKMODEL_HPP_
 
+#include "DefaultParserImpl.hpp"
 #include "ElinkConcept.hpp"
+#include "FelixStatistics.hpp"
+#include "ParserExecutor.hpp"
+#include "WaitStrategy.hpp"
 
 #include "flxlibs/opmon/ElinkModel.pb.h"
 
 #include "packetformat/block_format.hpp"
+#include "packetformat/detail/block_parser.hpp"
 
 //#include "appfwk/DAQModuleHelper.hpp"
 #include "iomanager/IOManager.hpp"
@@ -23,14 +28,26 @@
 #include <folly/ProducerConsumerQueue.h>
 #include <nlohmann/json.hpp>
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <type_traits>
 
 namespace dunedaq::flxlibs {
 
-template<class TargetPayloadType>
+/**
+ * @brief ParserImpl is the ParserOperations of the block parser: DefaultParserImpl with run-time bound chunk
+ * operations, or a StaticParserImpl with the operations of the payload type inlined.
+ */
+template<class TargetPayloadType, class ParserImpl = DefaultParserImpl>
 class ElinkModel : public ElinkConcept
 {
 public:
@@ -45,9 +62,12 @@ public:
    */
   ElinkModel()
     : ElinkConcept()
+    , m_parser_impl()
     , m_run_marker{ false }
     , m_parser_thread(0)
-  {}
+  {
+    m_parser = std::make_unique<felix::packetformat::BlockParser<ParserImpl>>(m_parser_impl);
+  }
   ~ElinkModel() {}
 
   void set_sink(const std::string& sink_name) override
@@ -64,9 +84,12 @@ public:
 
   std::shared_ptr<err_sink_t>& get_error_sink() { return m_error_sink_queue; }
 
+  ParserImpl& get_parser() { return std::ref(m_parser_impl); }
+
   void init(const size_t block_queue_capacity)
   {
-    m_block_addr_queue = std::make_unique<folly::ProducerConsumerQueue<uint64_t>>(block_queue_capacity); // NOLINT
+    m_block_queue_capacity = block_queue_capacity;
+    m_block_addr_queue = std::make_unique<BlockAddrQueue>(block_queue_capacity);
   }
 
   void conf(size_t block_size, bool is_32b_trailers)
@@ -79,6 +102,27 @@ public:
       // ers::fatal(ElinkConfigurationInconsistency(ERS_HERE, m_num_links));
 
       m_parser->configure(block_size, is_32b_trailers); // unsigned bsize, bool trailer_is_32bit
+      m_is_32b_trailers = is_32b_trailers;
+      m_parser_impl.set_detailed_stats(inherited::m_detailed_stats);
+      if (inherited::m_latency_tracking) {
+        m_latency_stats = std::make_unique<stats::LatencyStats>();
+        m_parser_impl.set_sink_latency(&m_latency_stats->sink);
+        // Only then the blocks carry the time of their DMA window
+        m_timed_block_queue = std::make_unique<TimedBlockQueue>(m_block_queue_capacity);
+        m_block_addr_queue.reset();
+        m_published_latency_stats.store(m_latency_stats.get(), std::memory_order_release);
+      }
+      if constexpr (!std::is_same_v<ParserImpl, DefaultParserImpl>) { // run-time bound operations own their copy
+        m_parser_impl.set_send_timeout(inherited::m_send_timeout);
+        m_parser_impl.set_streaming_copy_threshold(inherited::m_streaming_copy_threshold);
+      }
+      if constexpr (ParserImpl::uses_payload_pool) {
+        m_payload_pool =
+          ParserImpl::create_payload_pool(inherited::m_payload_pool_capacity, inherited::m_payload_pool_max_size);
+        m_parser_impl.set_payload_pool(m_payload_pool.get());
+        m_published_payload_pool.store(m_payload_pool.get(), std::memory_order_release);
+      }
+      inherited::m_block_size = block_size;
       m_configured = true;
     }
   }
@@ -88,7 +132,11 @@ public:
     m_t0 = std::chrono::high_resolution_clock::now();
     if (!m_run_marker.load()) {
       set_running(true);
-      m_parser_thread.set_work(&ElinkModel::process_elink, this);
+      if (inherited::m_executor == nullptr) {
+        m_idle.reset();
+        m_parser_active = true;
+        m_parser_thread.set_work(&ElinkModel::process_elink, this);
+      }
       TLOG() << "Started ElinkModel of link " << inherited::m_link_id << "...";
     } else {
       TLOG_DEBUG(5) << "ElinkModel of link " << inherited::m_link_id << " is already running!";
@@ -97,10 +145,20 @@ public:
 
   void stop()
   {
-    if (m_run_marker.load()) {
+    if (m_run_marker.load() && inherited::m_executor != nullptr) {
+      // The executor is stopped first, and no worker parses this elink any more: parse what it left queued
       set_running(false);
+      drain();
+      TLOG_DEBUG(5) << "Stopped ElinkModel of link " << m_link_id << "!";
+    } else if (m_run_marker.load()) {
+      set_running(false);
+      m_idle.interrupt();
+      {
+        std::unique_lock<std::mutex> lk(m_parser_mutex);
+        m_parser_cv.wait(lk, [this]() { return !m_parser_active; });
+      }
       while (!m_parser_thread.get_readiness()) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        std::this_thread::yield();
       }
       TLOG_DEBUG(5) << "Stopped ElinkModel of link " << m_link_id << "!";
     } else {
@@ -114,9 +172,16 @@ public:
     TLOG_DEBUG(5) << "Active state was toggled from " << was_running << " to " << should_run;
   }
 
-  bool queue_in_block_address(uint64_t block_addr) // NOLINT(build/unsigned)
+  bool queue_in_block_address(uint64_t block_addr, uint64_t window_ns) override // NOLINT(build/unsigned)
   {
-    if (m_block_addr_queue->write(block_addr)) { // ok write
+    bool queued = m_timed_block_queue ? queue_in(*m_timed_block_queue, TimedBlock{ block_addr, window_ns })
+                                      : queue_in(*m_block_addr_queue, block_addr);
+    if (queued) { // ok write
+      if (inherited::m_executor != nullptr) {
+        inherited::m_executor->notify(this);
+      } else {
+        m_idle.unpark(); // a fence and a load, unless the parser parked
+      }
       return true;
     } else { // failed write
       return false;
@@ -124,30 +189,94 @@ public:
   }
 
 
+  std::size_t parse_batch() override
+  {
+    // Parse up to a batch of blocks back to back, then publish their stats at once
+    std::size_t num_blocks = m_timed_block_queue ? parse_queued(*m_timed_block_queue, inherited::m_batch_size)
+                                                 : parse_queued(*m_block_addr_queue, inherited::m_batch_size);
+    if (num_blocks > 0) {
+      m_parser_impl.publish_stats();
+      if (!m_pinned_blocks.empty()) { // a chunk is open: time it
+        m_last_block_ns = stats::steady_clock_ns();
+      }
+    }
+    return num_blocks;
+  }
+
+  bool has_blocks() override
+  {
+    return m_timed_block_queue ? !m_timed_block_queue->isEmpty() : !m_block_addr_queue->isEmpty();
+  }
+
+  void release_stale_chunk() override
+  {
+    if (m_pinned_blocks.empty() || inherited::m_stale_chunk_timeout.count() == 0 ||
+        stats::steady_clock_ns() - m_last_block_ns <
+          static_cast<uint64_t>(std::chrono::nanoseconds(inherited::m_stale_chunk_timeout).count())) { // NOLINT
+      return;
+    }
+    // The BlockParser keeps the chunk it assembles: a new one starts from the next block on
+    m_parser = std::make_unique<felix::packetformat::BlockParser<ParserImpl>>(m_parser_impl);
+    m_parser->configure(inherited::m_block_size, m_is_32b_trailers);
+    m_parser_impl.discard_open_chunk();
+    m_last_chunk_boundaries = m_parser_impl.get_chunk_boundaries();
+    release_pinned_blocks(0);
+    m_stale_chunk_ctr.fetch_add(1, std::memory_order_relaxed);
+  }
+
 protected:
   void generate_opmon_data() override {
 
     opmon::CardReaderInfo info;
     auto now = std::chrono::high_resolution_clock::now();
-    auto& stats = m_parser_impl.get_stats();
+    // The counters never reset: report the counts since the last snapshot
+    auto snapshot = stats::snapshot(m_parser_impl.get_stats());
+    auto stats = stats::diff(snapshot, m_last_stats);
+    m_last_stats = snapshot;
 
     double seconds = std::chrono::duration_cast<std::chrono::microseconds>(now - m_t0).count() / 1000000.;
 
-    info.set_num_short_chunks_processed( stats.short_ctr.exchange(0) );
-    info.set_num_chunks_processed( stats.chunk_ctr.exchange(0) );
-    info.set_num_subchunks_processed(stats.subchunk_ctr.exchange(0));
-    info.set_num_blocks_processed(stats.block_ctr.exchange(0));
+    info.set_num_short_chunks_processed(stats.short_ctr);
+    info.set_num_chunks_processed(stats.chunk_ctr);
+    info.set_num_subchunks_processed(stats.subchunk_ctr);
+    info.set_num_blocks_processed(stats.block_ctr);
 
     info.set_rate_blocks_processed(info.num_blocks_processed() / seconds / 1000. );
     info.set_rate_chunks_processed(info.num_chunks_processed() / seconds / 1000. );
 
-    info.set_num_short_chunks_processed_with_error(stats.error_short_ctr.exchange(0));
-    info.set_num_chunks_processed_with_error(stats.error_chunk_ctr.exchange(0));
-    info.set_num_subchunks_processed_with_error(stats.error_subchunk_ctr.exchange(0));
-    info.set_num_blocks_processed_with_error(stats.error_block_ctr.exchange(0));
-    info.set_num_subchunk_crc_errors(stats.subchunk_crc_error_ctr.exchange(0));
-    info.set_num_subchunk_trunc_errors(stats.subchunk_trunc_error_ctr.exchange(0));
-    info.set_num_subchunk_errors(stats.subchunk_error_ctr.exchange(0));
+    info.set_num_short_chunks_processed_with_error(stats.error_short_ctr);
+    info.set_num_chunks_processed_with_error(stats.error_chunk_ctr);
+    info.set_num_subchunks_processed_with_error(stats.error_subchunk_ctr);
+    info.set_num_blocks_processed_with_error(stats.error_block_ctr);
+    info.set_num_subchunk_crc_errors(stats.subchunk_crc_error_ctr);
+    info.set_num_subchunk_trunc_errors(stats.subchunk_trunc_error_ctr);
+    info.set_num_subchunk_errors(stats.subchunk_error_ctr);
+    info.set_num_queue_full(m_queue_full_ctr.exchange(0));
+    info.set_num_blocks_dropped_queue_full(m_dropped_block_ctr.exchange(0));
+    info.set_num_payloads_dropped_sink_full(stats.dropped_payload_ctr);
+    info.set_num_stale_chunks_dropped(m_stale_chunk_ctr.exchange(0));
+    if (inherited::m_detailed_stats) {
+      info.set_num_chunk_bytes_processed(stats.chunk_bytes_ctr);
+      info.set_rate_chunk_bytes_processed(stats.chunk_bytes_ctr / seconds / 1000000.);
+      info.set_chunk_size_bin_0(stats.chunk_size_histogram[0]);
+      info.set_chunk_size_bin_1(stats.chunk_size_histogram[1]);
+      info.set_chunk_size_bin_2(stats.chunk_size_histogram[2]);
+      info.set_chunk_size_bin_3(stats.chunk_size_histogram[3]);
+      info.set_chunk_size_bin_4(stats.chunk_size_histogram[4]);
+      info.set_chunk_size_bin_5(stats.chunk_size_histogram[5]);
+      info.set_chunk_size_bin_6(stats.chunk_size_histogram[6]);
+      info.set_chunk_size_bin_7(stats.chunk_size_histogram[7]);
+    }
+    if constexpr (ParserImpl::uses_payload_pool) {
+      // The pool is created by conf, after the model is registered for monitoring
+      auto* payload_pool = m_published_payload_pool.load(std::memory_order_acquire);
+      if (payload_pool != nullptr) {
+        auto pool_stats = payload_pool->get_stats();
+        info.set_num_payload_pool_hits(pool_stats.hits);
+        info.set_num_payload_pool_misses(pool_stats.misses);
+        info.set_num_payload_pool_exhausted(pool_stats.exhausted);
+      }
+    }
 
 
     TLOG_DEBUG(2) << inherited::m_elink_str // Move to TLVL_TAKE_NOTE from readout
@@ -160,7 +289,9 @@ protected:
 		  << " Error Chunks: " << info.num_chunks_processed_with_error()
 		  << " Error Shorts: " << info.num_short_chunks_processed_with_error()
 		  << " Error Subchunks: " << info.num_subchunks_processed_with_error()
-		  << " Error Block: " << info.num_blocks_processed_with_error();
+		  << " Error Block: " << info.num_blocks_processed_with_error()
+		  << " Dropped Blocks: " << info.num_blocks_dropped_queue_full()
+		  << " Dropped Payloads: " << info.num_payloads_dropped_sink_full();
 
     m_t0 = now;
 
@@ -169,12 +300,64 @@ protected:
 	       { "logical_unit", std::to_string(m_logical_unit) },
 	       { "link", std::to_string(m_link_id) },
 	       { "tag", std::to_string(m_link_tag) } } );
-	     
+
+    // Like the pool, the histograms are created by conf, after the model is registered for monitoring
+    auto* latency_stats = m_published_latency_stats.load(std::memory_order_acquire);
+    if (latency_stats != nullptr) {
+      publish_latency("queue_wait", latency_stats->queue_wait, m_last_latency[0]);
+      publish_latency("parse", latency_stats->parse, m_last_latency[1]);
+      publish_latency("sink", latency_stats->sink, m_last_latency[2]);
+    }
+  }
+
+  void publish_latency(const std::string& stage,
+                       const stats::LatencyHistogram& histogram,
+                       stats::LatencyHistogram::snapshot_t& last)
+  {
+    auto snapshot = histogram.snapshot();
+    auto counts = snapshot;
+    uint64_t num_samples = 0; // NOLINT(build/unsigned)
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+      counts[i] -= last[i];
+      num_samples += counts[i];
+    }
+    last = snapshot;
+
+    opmon::LatencyInfo info;
+    info.set_num_samples(num_samples);
+    info.set_p50_us(stats::LatencyHistogram::percentile(counts, 0.5) / 1000.);
+    info.set_p90_us(stats::LatencyHistogram::percentile(counts, 0.9) / 1000.);
+    info.set_p99_us(stats::LatencyHistogram::percentile(counts, 0.99) / 1000.);
+    info.set_p999_us(stats::LatencyHistogram::percentile(counts, 0.999) / 1000.);
+    info.set_max_us(stats::LatencyHistogram::percentile(counts, 1.) / 1000.);
+    publish(std::move(info),
+            { { "card", std::to_string(m_card_id) },
+              { "logical_unit", std::to_string(m_logical_unit) },
+              { "link", std::to_string(m_link_id) },
+              { "tag", std::to_string(m_link_tag) },
+              { "stage", stage } });
   }
 
 private:
+  // Block Parser
+  ParserImpl m_parser_impl;
+  std::unique_ptr<felix::packetformat::BlockParser<ParserImpl>> m_parser;
+  stats::ParserSnapshot m_last_stats; // of the parser stats, at the last generate_opmon_data
+  std::unique_ptr<stats::LatencyStats> m_latency_stats; // only with latency tracking
+  std::atomic<stats::LatencyStats*> m_published_latency_stats{ nullptr }; // for generate_opmon_data
+  std::array<stats::LatencyHistogram::snapshot_t, 3> m_last_latency{};
+  // Of the payloads, if the parser allocates them from one: freed once the model and all its payloads are gone
+  std::shared_ptr<typename ParserImpl::payload_pool_t> m_payload_pool;
+  std::atomic<typename ParserImpl::payload_pool_t*> m_published_payload_pool{ nullptr };
+
   // Types
-  using UniqueBlockAddrQueue = std::unique_ptr<folly::ProducerConsumerQueue<uint64_t>>; // NOLINT(build/unsigned)
+  struct TimedBlock
+  {
+    uint64_t addr;      // NOLINT(build/unsigned)
+    uint64_t window_ns; // NOLINT(build/unsigned)
+  };
+  using BlockAddrQueue = folly::ProducerConsumerQueue<uint64_t>; // NOLINT(build/unsigned)
+  using TimedBlockQueue = folly::ProducerConsumerQueue<TimedBlock>;
 
   // Internals
   std::atomic<bool> m_run_marker;
@@ -185,26 +368,178 @@ private:
   std::shared_ptr<sink_t> m_sink_queue;
   std::shared_ptr<err_sink_t> m_error_sink_queue;
 
-  // blocks to process
-  UniqueBlockAddrQueue m_block_addr_queue;
+  // blocks to process: their addresses, or with latency tracking their addresses and DMA window times
+  std::size_t m_block_queue_capacity{ 0 };
+  std::unique_ptr<BlockAddrQueue> m_block_addr_queue;
+  std::unique_ptr<TimedBlockQueue> m_timed_block_queue;
+
+  // Parsed blocks not released yet, oldest first: those of the chunk being assembled (release tracking)
+  std::deque<uint64_t> m_pinned_blocks;   // NOLINT(build/unsigned)
+  uint64_t m_last_chunk_boundaries{ 0 }; // NOLINT(build/unsigned)
+  uint64_t m_last_block_ns{ 0 };         // NOLINT(build/unsigned) of the last batch parsed with a chunk open
+  bool m_is_32b_trailers{ false };
+  stats::counter_t m_stale_chunk_ctr{ 0 };
+  stats::counter_t m_queue_full_ctr{ 0 };
+  stats::counter_t m_dropped_block_ctr{ 0 };
+
+  template<class Queue, class Block>
+  bool queue_in(Queue& queue, const Block& block)
+  {
+    return queue.write(block) || queue_in_on_overflow(queue, block);
+  }
+
+  // Cold path of queue_in_block_address, called by the router when the queue is full
+  template<class Queue, class Block>
+  bool queue_in_on_overflow(Queue& queue, const Block& block)
+  {
+    m_queue_full_ctr.fetch_add(1, std::memory_order_relaxed);
+    switch (inherited::m_overflow_policy) {
+      case OverflowPolicy::kDrop:
+        break;
+      case OverflowPolicy::kSpinRetry:
+        for (std::size_t i = 0; i < inherited::m_overflow_spin_count; ++i) {
+          cpu_relax();
+          if (queue.write(block)) {
+            return true;
+          }
+        }
+        break;
+      case OverflowPolicy::kStall: {
+        // The parser keeps running until the card is stopped, so the queue eventually makes room. Spin for the
+        // overflow budget, then back off exponentially up to m_max_stall_sleep, giving the core to the parser.
+        std::size_t spins = 0;
+        auto sleep = std::chrono::microseconds(1);
+        while (m_run_marker.load(std::memory_order_relaxed)) {
+          if (queue.write(block)) {
+            return true;
+          }
+          if (spins < inherited::m_overflow_spin_count) {
+            cpu_relax();
+            ++spins;
+          } else {
+            std::this_thread::sleep_for(sleep);
+            sleep = std::min(sleep * 2, m_max_stall_sleep);
+          }
+        }
+        break;
+      }
+    }
+    m_dropped_block_ctr.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
 
   // Processor
   inline static const std::string m_parser_thread_name = "elinkp";
+  static constexpr std::chrono::microseconds m_max_park_time{ 10000 }; // bounds the reaction to the run marker
+  static constexpr std::chrono::microseconds m_max_stall_sleep{ 100 };  // of the router on a full queue
   utilities::ReusableThread m_parser_thread;
+  Parker m_idle;
+  std::mutex m_parser_mutex;
+  std::condition_variable m_parser_cv;
+  bool m_parser_active{ false };
+
   void process_elink()
   {
+    pin_current_thread(inherited::m_cpus, inherited::m_elink_str);
+    std::size_t idle_spins = 0;
     while (m_run_marker.load()) {
-      uint64_t block_addr;                        // NOLINT
-      if (m_block_addr_queue->read(block_addr)) { // read success
-        const auto* block = const_cast<felix::packetformat::block*>(
-          felix::packetformat::block_from_bytes(reinterpret_cast<const char*>(block_addr)) // NOLINT
-        );
-        m_parser->process(block);
-      } else { // couldn't read from queue
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      if (parse_batch() > 0) { // read success
+        idle_spins = 0;
+      } else if (idle_spins < inherited::m_idle_spin_count) { // spin for a while on an empty queue
+        cpu_relax();
+        ++idle_spins;
+      } else { // then park until the router queues a block
+        m_idle.park([this]() { return has_blocks(); }, m_max_park_time);
+        release_stale_chunk();
+        idle_spins = 0;
       }
     }
+    drain();
+    {
+      std::lock_guard<std::mutex> lk(m_parser_mutex);
+      m_parser_active = false;
+    }
+    m_parser_cv.notify_all();
   }
+
+  // The producers are stopped first, so what is left in the queue is the last of this run
+  void drain()
+  {
+    if (m_timed_block_queue) {
+      parse_queued(*m_timed_block_queue, SIZE_MAX);
+    } else {
+      parse_queued(*m_block_addr_queue, SIZE_MAX);
+    }
+    // The DMA is stopped: the blocks of an unfinished chunk can't be overwritten before the next start
+    release_pinned_blocks(0);
+    m_parser_impl.publish_stats();
+  }
+
+  // Releases the blocks no chunk references any more. The chunk being assembled by the BlockParser references
+  // the blocks since the one it started in: once a chunk ended in a block, the ones before it are done with.
+  void release_parsed_block(uint64_t block_addr) // NOLINT(build/unsigned)
+  {
+    m_pinned_blocks.push_back(block_addr);
+    auto chunk_boundaries = m_parser_impl.get_chunk_boundaries();
+    if (!m_parser_impl.has_open_chunk()) {
+      release_pinned_blocks(0);
+    } else if (chunk_boundaries != m_last_chunk_boundaries) {
+      release_pinned_blocks(1); // the open chunk started in this block
+    }
+    m_last_chunk_boundaries = chunk_boundaries;
+  }
+
+  void release_pinned_blocks(std::size_t keep)
+  {
+    while (m_pinned_blocks.size() > keep) {
+      inherited::m_release_block(m_pinned_blocks.front());
+      m_pinned_blocks.pop_front();
+    }
+  }
+
+  template<class Queue>
+  std::size_t parse_queued(Queue& queue, std::size_t max_blocks)
+  {
+    typename Queue::value_type queued_block;
+    std::size_t num_blocks = 0;
+    while (num_blocks < max_blocks && queue.read(queued_block)) {
+      process_block(queued_block, queue);
+      ++num_blocks;
+    }
+    return num_blocks;
+  }
+
+  static uint64_t block_addr(uint64_t addr) { return addr; }                  // NOLINT(build/unsigned)
+  static uint64_t block_addr(const TimedBlock& block) { return block.addr; } // NOLINT(build/unsigned)
+
+  void process_block(const TimedBlock& timed_block, TimedBlockQueue& queue)
+  {
+    uint64_t t_dequeue = stats::steady_clock_ns(); // NOLINT(build/unsigned)
+    if (timed_block.window_ns != 0 && timed_block.window_ns < t_dequeue) {
+      m_latency_stats->queue_wait.record(t_dequeue - timed_block.window_ns);
+    }
+    process_block(timed_block.addr, queue);
+    m_latency_stats->parse.record(stats::steady_clock_ns() - t_dequeue);
+  }
+
+  template<class Queue>
+  void process_block(uint64_t addr, Queue& queue) // NOLINT(build/unsigned)
+  {
+    const auto* block = const_cast<felix::packetformat::block*>(
+      felix::packetformat::block_from_bytes(reinterpret_cast<const char*>(addr)) // NOLINT
+    );
+    if (inherited::m_prefetch) {
+      const auto* next_block = queue.frontPtr();
+      if (next_block != nullptr) {
+        prefetch_block(block_addr(*next_block), inherited::m_block_size);
+      }
+    }
+    m_parser->process(block);
+    if (inherited::m_release_block) {
+      release_parsed_block(addr);
+    }
+  }
+
 };
 
 } // namespace dunedaq::flxlibs
@@ -0,0 +1,100 @@
+/**
+ * @file ElinkModelRegistry.hpp Registry of the payload types an ElinkModel
+ * can be created for, keyed by their DUNE DAQ type string.
+ *
+ * This is part of the DUNE DAQ , copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef FLXLIBS_SRC_ELINKMODELREGISTRY_HPP_
+#define FLXLIBS_SRC_ELINKMODELREGISTRY_HPP_
+
+#include "ElinkConcept.hpp"
+#include "ElinkModel.hpp"
+#include "StaticParserImpl.hpp"
+
+#include "iomanager/IOManager.hpp"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dunedaq::flxlibs {
+
+/**
+ * @brief Maps the data type of an output connection to the factory of its ElinkModel. Payload types register
+ * themselves with ElinkModelRegistrar, so a new format only needs a registration next to its type string.
+ */
+class ElinkModelRegistry
+{
+public:
+  using factory_t = std::function<std::unique_ptr<ElinkConcept>(const std::string& conn_uid)>;
+
+  static ElinkModelRegistry& get()
+  {
+    static ElinkModelRegistry registry;
+    return registry;
+  }
+
+  void add(const std::string& data_type, factory_t factory)
+  {
+    m_factories.emplace_back(data_type, std::move(factory));
+  }
+
+  // ElinkModel for the data type: the one registered under that exact name, or else the first registered name
+  // the data type contains. nullptr if there is none.
+  std::unique_ptr<ElinkConcept> create(const std::string& data_type, const std::string& conn_uid) const
+  {
+    for (const auto& [name, factory] : m_factories) {
+      if (name == data_type) {
+        return factory(conn_uid);
+      }
+    }
+    for (const auto& [name, factory] : m_factories) {
+      if (data_type.find(name) != std::string::npos) {
+        return factory(conn_uid);
+      }
+    }
+    return nullptr;
+  }
+
+  // Registered data types, comma separated, e.g.: for the logs
+  std::string get_data_types() const
+  {
+    std::string data_types;
+    for (const auto& [name, factory] : m_factories) {
+      data_types += (data_types.empty() ? "" : ", ") + name;
+    }
+    return data_types;
+  }
+
+private:
+  ElinkModelRegistry() = default;
+
+  std::vector<std::pair<std::string, factory_t>> m_factories; // in registration order
+};
+
+/**
+ * @brief Registers TargetPayloadType under its DUNE_DAQ_TYPESTRING, or under the given name, with an ElinkModel
+ * parsing through StaticParserImpl<TargetPayloadType, SinkPolicy>: the chunk operations inlined into the parser.
+ */
+template<class TargetPayloadType, class SinkPolicy>
+struct ElinkModelRegistrar
+{
+  explicit ElinkModelRegistrar(const std::string& data_type = datatype_to_string<TargetPayloadType>())
+  {
+    ElinkModelRegistry::get().add(data_type, [](const std::string& conn_uid) -> std::unique_ptr<ElinkConcept> {
+      auto elink_model =
+        std::make_unique<ElinkModel<TargetPayloadType, StaticParserImpl<TargetPayloadType, SinkPolicy>>>();
+      elink_model->set_sink(conn_uid);
+      elink_model->get_parser().set_sink(elink_model->get_sink());
+      return elink_model;
+    });
+  }
+};
+
+} // namespace dunedaq::flxlibs
+
+#endif // FLXLIBS_SRC_ELINKMODELREGISTRY_HPP_
@@ -0,0 +1,293 @@
+/**
+ * @file EmulatedDMASource.cpp Software emulation of the FELIX to-host DMA
+ *
+ * This is part of the DUNE DAQ , copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+// From Module
+#include "EmulatedDMASource.hpp"
+#include "FelixIssues.hpp"
+
+#include "logging/Logging.hpp"
+
+#include "packetformat/block_format.hpp"
+
+// From STD
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include <sys/mman.h>
+
+/**
+ * @brief TRACE debug levels used in this source file
+ */
+enum
+{
+  TLVL_ENTER_EXIT_METHODS = 5,
+  TLVL_WORK_STEPS = 10,
+  TLVL_BOOKKEEPING = 15
+};
+
+namespace dunedaq {
+namespace flxlibs {
+
+EmulatedDMASource::EmulatedDMASource(const std::string& id_str, std::size_t block_size)
+  : m_id_str(id_str)
+  , m_block_size(block_size)
+{}
+
+EmulatedDMASource::~EmulatedDMASource()
+{
+  close_card();
+}
+
+void
+EmulatedDMASource::load_block_templates(const std::string& filename)
+{
+  std::ifstream ifs(filename, std::ios::binary | std::ios::ate);
+  if (!ifs.is_open()) {
+    throw flxlibs::ConfigurationError(ERS_HERE, "Couldn't open block template file: " + filename);
+  }
+  std::size_t filesize = ifs.tellg();
+  std::size_t num_blocks = filesize / m_block_size;
+  if (num_blocks == 0) {
+    throw flxlibs::ConfigurationError(ERS_HERE, "Block template file is shorter than a single block: " + filename);
+  }
+  m_block_templates.resize(num_blocks * m_block_size);
+  ifs.seekg(0, std::ios::beg);
+  ifs.read(m_block_templates.data(), m_block_templates.size());
+  TLOG_DEBUG(TLVL_WORK_STEPS) << "Emulated DMA " << m_id_str << " loaded " << num_blocks << " block templates from "
+                              << filename;
+}
+
+void
+EmulatedDMASource::open_card(const std::vector<uint8_t>& dma_ids) // NOLINT
+{
+  TLOG_DEBUG(TLVL_WORK_STEPS) << "Opening emulated FELIX card " << m_id_str;
+  if (m_elinks.empty()) {
+    m_elinks.push_back(0);
+  }
+  if (m_elinks.size() < dma_ids.size()) {
+    throw flxlibs::ConfigurationError(ERS_HERE,
+                                      "Emulated DMA " + m_id_str + " has " + std::to_string(m_elinks.size()) +
+                                        " elinks for " + std::to_string(dma_ids.size()) + " DMA descriptors");
+  }
+  m_dma_ids = dma_ids;
+}
+
+void
+EmulatedDMASource::close_card()
+{
+  TLOG_DEBUG(TLVL_WORK_STEPS) << "Closing emulated FELIX card " << m_id_str;
+  std::lock_guard<std::mutex> lk(m_channels_mutex);
+  for (auto& [dma_id, channel] : m_channels) {
+    channel->run_marker.store(false);
+    if (channel->generator.joinable()) {
+      channel->generator.join();
+    }
+  }
+  m_channels.clear();
+  for (auto& [addr, size] : m_allocations) {
+    munmap(addr, size);
+  }
+  m_allocations.clear();
+}
+
+int
+EmulatedDMASource::allocate_buffer(uint8_t /*numa*/, std::size_t bsize, uint64_t* paddr, uint64_t* vaddr) // NOLINT
+{
+  TLOG_DEBUG(TLVL_WORK_STEPS) << "Allocating emulated DMA buffer " << m_id_str << " of " << bsize << " Bytes.";
+  void* addr = MAP_FAILED;
+  if (m_use_hugepages) {
+    addr = mmap(nullptr, bsize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (addr == MAP_FAILED) {
+      TLOG_DEBUG(TLVL_WORK_STEPS) << "Hugepage allocation failed, falling back to regular pages.";
+    }
+  }
+  if (addr == MAP_FAILED) {
+    addr = mmap(nullptr, bsize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  }
+  if (addr == MAP_FAILED) {
+    throw flxlibs::CardError(ERS_HERE, "Couldn't allocate memory for the emulated DMA buffer.");
+  }
+  std::lock_guard<std::mutex> lk(m_channels_mutex);
+  m_allocations.emplace_back(addr, bsize);
+  // There is no IOMMU in the loop: physical and virtual addresses are the same.
+  *paddr = reinterpret_cast<uint64_t>(addr); // NOLINT
+  *vaddr = reinterpret_cast<uint64_t>(addr); // NOLINT
+  return static_cast<int>(m_allocations.size() - 1);
+}
+
+EmulatedDMASource::Channel&
+EmulatedDMASource::get_channel(uint8_t dma_id) // NOLINT
+{
+  std::lock_guard<std::mutex> lk(m_channels_mutex);
+  auto& channel = m_channels[dma_id];
+  if (channel == nullptr) {
+    channel = std::make_unique<Channel>();
+  }
+  return *channel;
+}
+
+void
+EmulatedDMASource::init_DMA(const std::vector<uint8_t>& dma_ids, bool interrupt_mode) // NOLINT
+{
+  for (auto dma_id : dma_ids) {
+    auto& channel = get_channel(dma_id);
+    channel.interrupt_mode = interrupt_mode;
+    channel.current_address.store(channel.base);
+    channel.read_pointer.store(channel.base);
+  }
+}
+
+void
+EmulatedDMASource::start_DMA(uint8_t dma_id, uint64_t paddr, std::size_t bsize) // NOLINT
+{
+  TLOG_DEBUG(TLVL_WORK_STEPS) << "Starting emulated DMA for " << m_id_str << " dma id:" << std::to_string(dma_id)
+                              << " rate:" << m_rate << " B/s";
+  auto& channel = get_channel(dma_id);
+  if (channel.run_marker.load()) {
+    TLOG_DEBUG(TLVL_WORK_STEPS) << "Emulated DMA is already running.";
+    return;
+  }
+  channel.elinks.clear();
+  for (std::size_t i = 0; i < m_dma_ids.size(); ++i) {
+    if (m_dma_ids[i] == dma_id) {
+      for (std::size_t j = i; j < m_elinks.size(); j += m_dma_ids.size()) {
+        channel.elinks.push_back(m_elinks[j]);
+      }
+    }
+  }
+  if (channel.elinks.empty()) {
+    throw flxlibs::ConfigurationError(ERS_HERE, "Emulated DMA " + std::to_string(dma_id) + " of " + m_id_str +
+                                                  " wasn't opened, or has no elinks");
+  }
+  channel.base = paddr;
+  channel.size = bsize - (bsize % m_block_size);
+  channel.current_address.store(paddr);
+  channel.read_pointer.store(paddr);
+  channel.run_marker.store(true);
+  channel.generator = std::thread(&EmulatedDMASource::generate, this, std::ref(channel));
+}
+
+void
+EmulatedDMASource::stop_DMA(uint8_t dma_id) // NOLINT
+{
+  TLOG_DEBUG(TLVL_WORK_STEPS) << "Stopping emulated DMA for " << m_id_str << " dma id:" << std::to_string(dma_id);
+  auto& channel = get_channel(dma_id);
+  channel.run_marker.store(false);
+  if (channel.generator.joinable()) {
+    channel.generator.join();
+  }
+  channel.irq_cv.notify_all();
+}
+
+uint64_t // NOLINT
+EmulatedDMASource::read_current_address(uint8_t dma_id) // NOLINT
+{
+  return get_channel(dma_id).current_address.load(std::memory_order_acquire);
+}
+
+void
+EmulatedDMASource::set_read_pointer(uint8_t dma_id, uint64_t paddr) // NOLINT
+{
+  get_channel(dma_id).read_pointer.store(paddr, std::memory_order_release);
+}
+
+void
+EmulatedDMASource::wait_for_data(uint8_t dma_id) // NOLINT
+{
+  auto& channel = get_channel(dma_id);
+  auto seen = channel.current_address.load(std::memory_order_acquire);
+  std::unique_lock<std::mutex> lk(channel.irq_mutex);
+  channel.irq_cv.wait_for(lk, std::chrono::milliseconds(m_irq_timeout_ms), [&]() {
+    return !channel.run_marker.load() || channel.wait_cancelled.load() ||
+           channel.current_address.load(std::memory_order_acquire) != seen;
+  });
+  channel.wait_cancelled.store(false);
+}
+
+void
+EmulatedDMASource::cancel_wait(uint8_t dma_id) // NOLINT
+{
+  auto& channel = get_channel(dma_id);
+  {
+    std::lock_guard<std::mutex> lk(channel.irq_mutex);
+    channel.wait_cancelled.store(true);
+  }
+  channel.irq_cv.notify_all();
+}
+
+void
+EmulatedDMASource::fill_block(char* dest, uint64_t index, unsigned int elink, uint8_t seqnr) // NOLINT
+{
+  if (m_block_templates.empty()) {
+    std::memset(dest, 0, m_block_size);
+  } else {
+    auto num_templates = m_block_templates.size() / m_block_size;
+    std::memcpy(dest, m_block_templates.data() + (index % num_templates) * m_block_size, m_block_size);
+  }
+  auto* block = reinterpret_cast<felix::packetformat::block*>(dest); // NOLINT
+  block->elink = elink;
+  block->seqnr = seqnr;
+  if (m_block_templates.empty()) {
+    block->sob = m_start_of_block;
+  }
+}
+
+void
+EmulatedDMASource::generate(Channel& channel)
+{
+  TLOG_DEBUG(TLVL_WORK_STEPS) << "Emulated DMA generator of " << m_id_str << " started.";
+  const std::size_t num_blocks = channel.size / m_block_size;
+  const auto& elinks = channel.elinks;
+  std::vector<uint8_t> seqnrs(elinks.size(), 0); // NOLINT(build/unsigned)
+  std::size_t elink_idx = 0;
+  uint64_t blocks_generated = 0; // NOLINT(build/unsigned)
+  auto t0 = std::chrono::steady_clock::now();
+
+  while (channel.run_marker.load(std::memory_order_relaxed)) {
+    // Rate limiting: compare to the number of blocks that should have been written by now
+    if (m_rate > 0) {
+      double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+      auto blocks_due = static_cast<uint64_t>(elapsed * m_rate / m_block_size); // NOLINT(build/unsigned)
+      if (blocks_generated >= blocks_due) {
+        std::this_thread::yield();
+        continue;
+      }
+      if (blocks_due - blocks_generated > num_blocks) { // don't try to catch up more than a full buffer
+        blocks_generated = blocks_due - num_blocks;
+      }
+    }
+
+    // Back-pressure: the card never writes into the block the read pointer points to
+    uint64_t write_addr = channel.current_address.load(std::memory_order_relaxed); // NOLINT(build/unsigned)
+    uint64_t next_addr = write_addr + m_block_size;                                // NOLINT(build/unsigned)
+    if (next_addr == channel.base + channel.size) {
+      next_addr = channel.base;
+    }
+    if (next_addr == channel.read_pointer.load(std::memory_order_acquire)) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    fill_block(reinterpret_cast<char*>(write_addr), blocks_generated, elinks[elink_idx], seqnrs[elink_idx]); // NOLINT
+    seqnrs[elink_idx] = (seqnrs[elink_idx] + 1) % 32; // 5 bit block sequence number
+    elink_idx = (elink_idx + 1) % elinks.size();
+    ++blocks_generated;
+
+    channel.current_address.store(next_addr, std::memory_order_release);
+    if (channel.interrupt_mode) {
+      channel.irq_cv.notify_all();
+    }
+  }
+  TLOG_DEBUG(TLVL_WORK_STEPS) << "Emulated DMA generator of " << m_id_str << " finished after " << blocks_generated
+                              << " blocks.";
+}
+
+} // namespace flxlibs
+} // namespace dunedaq
@@ -0,0 +1,101 @@
+/**
+ * @file EmulatedDMASource.hpp Software emulation of the FELIX to-host DMA.
+ * Fills an anonymous (or hugepage backed) circular buffer with blocks at a
+ * configurable rate, advances a fake current address, and respects the read
+ * pointer set by the consumer, as the card does in wrap-around mode.
+ *
+ * This is part of the DUNE DAQ , copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef FLXLIBS_SRC_EMULATEDDMASOURCE_HPP_
+#define FLXLIBS_SRC_EMULATEDDMASOURCE_HPP_
+
+#include "DMASource.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace dunedaq::flxlibs {
+
+class EmulatedDMASource : public DMASource
+{
+public:
+  /**
+   * @brief EmulatedDMASource Constructor
+   * @param id_str Identifier string used for logging
+   * @param block_size Size of the emulated DMA blocks in bytes
+   */
+  explicit EmulatedDMASource(const std::string& id_str, std::size_t block_size = 4096);
+  ~EmulatedDMASource();
+
+  // Emulation parameters. To be set before start_DMA.
+  void set_rate(double bytes_per_second) { m_rate = bytes_per_second; } // 0 means as fast as possible, per DMA
+  // Like the firmware routes each link to a single descriptor, the elinks are dealt round robin to the opened DMA
+  // descriptors: each elink has a single producer. To be set before open_card.
+  void set_elinks(const std::vector<unsigned int>& elinks) { m_elinks = elinks; }
+  void set_start_of_block(uint16_t sob) { m_start_of_block = sob; } // NOLINT(build/unsigned)
+  void set_use_hugepages(bool use_hugepages) { m_use_hugepages = use_hugepages; }
+  // Replay blocks from a raw block dump (e.g.: a recording) instead of empty blocks.
+  void load_block_templates(const std::string& filename);
+
+  void open_card(const std::vector<uint8_t>& dma_ids) override; // NOLINT
+  void close_card() override;
+  int allocate_buffer(uint8_t numa, std::size_t bsize, uint64_t* paddr, uint64_t* vaddr) override; // NOLINT
+
+  void init_DMA(const std::vector<uint8_t>& dma_ids, bool interrupt_mode) override; // NOLINT
+  void start_DMA(uint8_t dma_id, uint64_t paddr, std::size_t bsize) override;      // NOLINT
+  void stop_DMA(uint8_t dma_id) override;                                          // NOLINT
+  uint64_t read_current_address(uint8_t dma_id) override;                          // NOLINT
+  void set_read_pointer(uint8_t dma_id, uint64_t paddr) override;                  // NOLINT
+  void wait_for_data(uint8_t dma_id) override;                                     // NOLINT
+  void cancel_wait(uint8_t dma_id) override;                                       // NOLINT
+
+private:
+  // Constants
+  static constexpr uint16_t m_default_start_of_block = 0xABCD; // NOLINT(build/unsigned)
+  static constexpr int m_irq_timeout_ms = 10;
+
+  // Per DMA descriptor state
+  struct Channel
+  {
+    uint64_t base{ 0 }; // NOLINT(build/unsigned)
+    std::size_t size{ 0 };
+    bool interrupt_mode{ false };
+    std::atomic<uint64_t> current_address{ 0 }; // NOLINT(build/unsigned)
+    std::atomic<uint64_t> read_pointer{ 0 };    // NOLINT(build/unsigned)
+    std::atomic<bool> run_marker{ false };
+    std::atomic<bool> wait_cancelled{ false };
+    std::vector<unsigned int> elinks; // generated by this descriptor only
+    std::thread generator;
+    std::mutex irq_mutex;
+    std::condition_variable irq_cv;
+  };
+  Channel& get_channel(uint8_t dma_id); // NOLINT(build/unsigned)
+  void generate(Channel& channel);
+  void fill_block(char* dest, uint64_t index, unsigned int elink, uint8_t seqnr); // NOLINT(build/unsigned)
+
+  std::string m_id_str;
+  std::size_t m_block_size;
+  double m_rate{ 0 };
+  std::vector<unsigned int> m_elinks{ 0 };
+  std::vector<uint8_t> m_dma_ids; // NOLINT(build/unsigned) opened, in the order their elinks are dealt
+  uint16_t m_start_of_block{ m_default_start_of_block }; // NOLINT(build/unsigned)
+  bool m_use_hugepages{ true };
+  std::vector<char> m_block_templates;
+
+  std::mutex m_channels_mutex;
+  std::map<uint8_t, std::unique_ptr<Channel>> m_channels; // NOLINT(build/unsigned)
+  std::vector<std::pair<void*, std::size_t>> m_allocations;
+};
+
+} // namespace dunedaq::flxlibs
+
+#endif // FLXLIBS_SRC_EMULATEDDMASOURCE_HPP_
@@ -43,6 +43,22 @@ ERS_DECLARE_ISSUE(flxlibs,
                   " Invalid FELIX block size and 32b trailer configuration requested: " << block_size,
                   ((int)block_size)) // NOLINT
 
+ERS_DECLARE_ISSUE(flxlibs,
+                  ThreadAffinityError,
+                  " Couldn't set the CPU affinity of " << thread << " (error: " << error << ")",
+                  ((std::string)thread)((int)error)) // NOLINT
+
+ERS_DECLARE_ISSUE(flxlibs,
+                  ThreadNUMAMismatch,
+                  " CPU " << cpu << " of " << thread << " is on NUMA node " << cpu_node
+                          << ", but the DMA memory is on NUMA node " << dma_node,
+                  ((std::string)thread)((int)cpu)((int)cpu_node)((int)dma_node)) // NOLINT
+
+ERS_DECLARE_ISSUE(flxlibs,
+                  BlockRecorderError,
+                  " Block recorder " << recorder << ": " << error,
+                  ((std::string)recorder)((std::string)error))
+
 ERS_DECLARE_ISSUE_BASE(flxlibs,
                        ResourceQueueError,
                        flxlibs::ConfigurationError,
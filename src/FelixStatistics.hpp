@@ -8,26 +8,216 @@
 #ifndef FLXLIBS_SRC_FELIXSTATISTICS_HPP_
 #define FLXLIBS_SRC_FELIXSTATISTICS_HPP_
 
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 
 namespace dunedaq::flxlibs::stats {
 
 using counter_t = std::atomic<uint64_t>; // NOLINT(build/unsigned)
 
-struct ParserStats
+// Parser counters, over the value type: plain for the thread local counters and the snapshots, atomic for the
+// stats shared with the monitoring thread.
+template<class T>
+struct ParserCountersOf
 {
-  counter_t packet_ctr{ 0 };
-  counter_t short_ctr{ 0 };
-  counter_t chunk_ctr{ 0 };
-  counter_t subchunk_ctr{ 0 };
+  static constexpr std::size_t num_chunk_size_bins = 8;
+
+  T packet_ctr{ 0 };
+  T short_ctr{ 0 };
+  T chunk_ctr{ 0 };
+  T subchunk_ctr{ 0 };
+  T block_ctr{ 0 };
+  T error_short_ctr{ 0 };
+  T error_chunk_ctr{ 0 };
+  T error_subchunk_ctr{ 0 };
+  T error_block_ctr{ 0 };
+  T subchunk_crc_error_ctr{ 0 };
+  T subchunk_trunc_error_ctr{ 0 };
+  T subchunk_error_ctr{ 0 };
+  T dropped_payload_ctr{ 0 };
+  // Detailed stats, only counted if enabled
+  T chunk_bytes_ctr{ 0 };
+  std::array<T, num_chunk_size_bins> chunk_size_histogram{}; // [0, 128), [128, 256), ..., [8192, inf) bytes
+};
+
+// Thread local counters of a parser, published to its ParserStats in one go
+using ParserCounters = ParserCountersOf<uint64_t>; // NOLINT(build/unsigned)
+
+// Values of a ParserStats at a point in time. Counters never reset, the monitoring diffs two snapshots.
+using ParserSnapshot = ParserCountersOf<uint64_t>; // NOLINT(build/unsigned)
+
+// Written by the parser thread only, with relaxed loads and stores instead of locked read-modify-writes.
+// Aligned to its own cache lines, so the parser doesn't share them with the data of other threads.
+struct alignas(64) ParserStats : ParserCountersOf<counter_t>
+{};
+
+// Calls f on the pairs of corresponding counters of a and b
+template<class A, class B, class F>
+inline void
+for_each_counter(A& a, B& b, F f)
+{
+  f(a.packet_ctr, b.packet_ctr);
+  f(a.short_ctr, b.short_ctr);
+  f(a.chunk_ctr, b.chunk_ctr);
+  f(a.subchunk_ctr, b.subchunk_ctr);
+  f(a.block_ctr, b.block_ctr);
+  f(a.error_short_ctr, b.error_short_ctr);
+  f(a.error_chunk_ctr, b.error_chunk_ctr);
+  f(a.error_subchunk_ctr, b.error_subchunk_ctr);
+  f(a.error_block_ctr, b.error_block_ctr);
+  f(a.subchunk_crc_error_ctr, b.subchunk_crc_error_ctr);
+  f(a.subchunk_trunc_error_ctr, b.subchunk_trunc_error_ctr);
+  f(a.subchunk_error_ctr, b.subchunk_error_ctr);
+  f(a.dropped_payload_ctr, b.dropped_payload_ctr);
+  f(a.chunk_bytes_ctr, b.chunk_bytes_ctr);
+  for (std::size_t i = 0; i < a.chunk_size_histogram.size(); ++i) {
+    f(a.chunk_size_histogram[i], b.chunk_size_histogram[i]);
+  }
+}
+
+// Counts the size of a chunk into the detailed stats
+inline void
+count_chunk_size(ParserCounters& counters, std::size_t size)
+{
+  counters.chunk_bytes_ctr += size;
+  std::size_t bin = 0;
+  while (bin + 1 < ParserCounters::num_chunk_size_bins && size >= (std::size_t(128) << bin)) {
+    ++bin;
+  }
+  counters.chunk_size_histogram[bin]++;
+}
+
+// Adds the counters to the stats and clears them. Single writer: no read-modify-write needed.
+inline void
+publish(ParserCounters& counters, ParserStats& stats)
+{
+  for_each_counter(stats, counters, [](counter_t& counter, uint64_t& value) { // NOLINT(build/unsigned)
+    if (value != 0) {
+      counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+      value = 0;
+    }
+  });
+}
+
+inline ParserSnapshot
+snapshot(const ParserStats& stats)
+{
+  ParserSnapshot values;
+  for_each_counter(values, stats, [](uint64_t& value, const counter_t& counter) { // NOLINT(build/unsigned)
+    value = counter.load(std::memory_order_relaxed);
+  });
+  return values;
+}
+
+// Counts between two snapshots
+inline ParserSnapshot
+diff(const ParserSnapshot& current, const ParserSnapshot& last)
+{
+  ParserSnapshot delta = current;
+  for_each_counter(delta, last, [](uint64_t& value, const uint64_t& last_value) { // NOLINT(build/unsigned)
+    value -= last_value;
+  });
+  return delta;
+}
+
+struct DMAStats
+{
+  static constexpr std::size_t num_fill_bins = 8;
+
+  counter_t window_ctr{ 0 };
   counter_t block_ctr{ 0 };
-  counter_t error_short_ctr{ 0 };
-  counter_t error_chunk_ctr{ 0 };
-  counter_t error_subchunk_ctr{ 0 };
-  counter_t error_block_ctr{ 0 };
-  counter_t subchunk_crc_error_ctr{ 0 };
-  counter_t subchunk_trunc_error_ctr{ 0 };
-  counter_t subchunk_error_ctr{ 0 };
+  counter_t max_blocks_per_window{ 0 };
+  counter_t wraparound_ctr{ 0 };
+  counter_t fill_bytes{ 0 };
+  counter_t max_fill_bytes{ 0 };
+  std::array<counter_t, num_fill_bins> fill_histogram{};
+  counter_t wait_ns{ 0 };
+  counter_t processing_ns{ 0 };
+};
+
+// Timestamps of the latency histograms
+inline uint64_t // NOLINT(build/unsigned)
+steady_clock_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+// Latency histogram with log-linear buckets, as in HDR histograms: every power of two of nanoseconds is split
+// into 4 sub-buckets, bounding the error of a recorded value to 25%. Single writer, read by snapshot like
+// ParserStats.
+class alignas(64) LatencyHistogram
+{
+public:
+  static constexpr std::size_t sub_bucket_bits = 2;
+  static constexpr std::size_t sub_buckets = std::size_t(1) << sub_bucket_bits;
+  static constexpr std::size_t num_buckets = (64 - sub_bucket_bits + 1) * sub_buckets;
+  using snapshot_t = std::array<uint64_t, num_buckets>; // NOLINT(build/unsigned)
+
+  void record(uint64_t ns) // NOLINT(build/unsigned)
+  {
+    auto& counter = m_buckets[bucket_of(ns)];
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  snapshot_t snapshot() const
+  {
+    snapshot_t values;
+    for (std::size_t i = 0; i < num_buckets; ++i) {
+      values[i] = m_buckets[i].load(std::memory_order_relaxed);
+    }
+    return values;
+  }
+
+  static std::size_t bucket_of(uint64_t ns) // NOLINT(build/unsigned)
+  {
+    if (ns < sub_buckets) {
+      return ns;
+    }
+    std::size_t msb = 63 - __builtin_clzll(ns);
+    return (msb - sub_bucket_bits + 1) * sub_buckets + ((ns >> (msb - sub_bucket_bits)) & (sub_buckets - 1));
+  }
+
+  // Largest value counted into the bucket
+  static uint64_t upper_bound_of(std::size_t bucket) // NOLINT(build/unsigned)
+  {
+    if (bucket < sub_buckets) {
+      return bucket;
+    }
+    std::size_t shift = bucket / sub_buckets - 1;
+    return ((sub_buckets + bucket % sub_buckets + 1) << shift) - 1;
+  }
+
+  // Value below which fraction of the counts of a snapshot (or of a diff of two) are, 0 without counts
+  static uint64_t percentile(const snapshot_t& counts, double fraction) // NOLINT(build/unsigned)
+  {
+    uint64_t total = 0; // NOLINT(build/unsigned)
+    for (auto count : counts) {
+      total += count;
+    }
+    uint64_t cumulative = 0; // NOLINT(build/unsigned)
+    for (std::size_t i = 0; i < num_buckets; ++i) {
+      cumulative += counts[i];
+      if (counts[i] != 0 && cumulative >= fraction * total) {
+        return upper_bound_of(i);
+      }
+    }
+    return 0;
+  }
+
+private:
+  std::array<counter_t, num_buckets> m_buckets{};
+};
+
+// Latencies of the blocks and chunks of an elink, from the DMA window they arrived in
+struct LatencyStats
+{
+  LatencyHistogram queue_wait; // from the DMA window to the parser dequeuing the block
+  LatencyHistogram parse;      // parse time of a block, including the copies and sends of its chunks
+  LatencyHistogram sink;       // copy into the payload and send of a chunk
 };
 
 } // namespace dunedaq::flxlibs::stats
@@ -0,0 +1,221 @@
+/**
+ * @file FlxCardDMASource.cpp DMASource backed by FELIX's FlxCard and CMEM_RCC
+ *
+ * This is part of the DUNE DAQ , copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+// From Module
+#include "FlxCardDMASource.hpp"
+#include "FelixDefinitions.hpp"
+#include "FelixIssues.hpp"
+
+#include "logging/Logging.hpp"
+
+#include "flxcard/FlxException.h"
+
+// From STD
+#include <limits>
+#include <memory>
+#include <string>
+
+/**
+ * @brief TRACE debug levels used in this source file
+ */
+enum
+{
+  TLVL_ENTER_EXIT_METHODS = 5,
+  TLVL_WORK_STEPS = 10,
+  TLVL_BOOKKEEPING = 15
+};
+
+namespace dunedaq {
+namespace flxlibs {
+
+FlxCardDMASource::FlxCardDMASource(uint8_t card_id, uint8_t logical_unit, const std::string& id_str)
+  : m_card_id(card_id)
+  , m_logical_unit(logical_unit)
+  , m_card_id_str(id_str)
+{
+  m_flx_card = std::make_unique<FlxCard>();
+  if (m_flx_card == nullptr) {
+    throw flxlibs::CardError(ERS_HERE, "Couldn't create FlxCard object.");
+  }
+}
+
+void
+FlxCardDMASource::open_card(const std::vector<uint8_t>& dma_ids) // NOLINT
+{
+  TLOG_DEBUG(TLVL_WORK_STEPS) << "Opening FELIX card (with DMA lock mask)" << m_card_id_str;
+  for (auto dma_id : dma_ids) {
+    if (dma_id >= std::numeric_limits<u_int>::digits) { // no bit in the lock mask
+      throw flxlibs::ConfigurationError(ERS_HERE, "DMA descriptor " + std::to_string(dma_id) + " is out of range");
+    }
+  }
+  try {
+    m_card_mutex.lock();
+    auto absolute_card_id = m_card_id + m_logical_unit;
+    u_int current_lock_mask = m_flx_card->get_lock_mask(absolute_card_id);
+    TLOG_DEBUG(TLVL_WORK_STEPS) << "Current lock mask for FELIX card " << m_card_id_str << " mask:" << int(current_lock_mask);
+    u_int to_lock_mask = 0;
+    for (auto dma_id : dma_ids) {
+      to_lock_mask |= u_int(1) << dma_id;
+    }
+    if (current_lock_mask & to_lock_mask) { // LOCK_NONE=0, LOCK_DMA0=1, LOCK_DMA1=2 from FlxCard.h
+      ers::fatal(flxlibs::CardError(ERS_HERE, "FELIX card's DMA is locked by another process!"));
+      exit(EXIT_FAILURE);
+    }
+    m_flx_card->card_open(static_cast<int>(absolute_card_id), to_lock_mask); // FlxCard.h
+    // To-host descriptors come first, the last one is the from-host descriptor
+    auto num_descriptors = m_flx_card->cfg_get_option(BF_GENERIC_CONSTANTS_DESCRIPTORS, false);
+    for (auto dma_id : dma_ids) {
+      if (dma_id + 1u >= num_descriptors) {
+        m_flx_card->card_close();
+        m_card_mutex.unlock();
+        auto message = "DMA descriptor " + std::to_string(dma_id) + " is not a to-host one of card " + m_card_id_str +
+                       ", out of " + std::to_string(num_descriptors);
+        throw flxlibs::ConfigurationError(ERS_HERE, message);
+      }
+    }
+    m_card_mutex.unlock();
+  } catch (FlxException& ex) {
+    ers::error(flxlibs::CardError(ERS_HERE, ex.what()));
+    exit(EXIT_FAILURE);
+  }
+}
+
+void
+FlxCardDMASource::close_card()
+{
+  TLOG_DEBUG(TLVL_WORK_STEPS) << "Closing FELIX card " << m_card_id_str;
+  try {
+    m_card_mutex.lock();
+    m_flx_card->card_close();
+    m_card_mutex.unlock();
+  } catch (FlxException& ex) {
+    ers::error(flxlibs::CardError(ERS_HERE, ex.what()));
+    exit(EXIT_FAILURE);
+  }
+}
+
+int
+FlxCardDMASource::allocate_buffer(uint8_t numa, std::size_t bsize, uint64_t* paddr, uint64_t* vaddr) // NOLINT
+{
+  TLOG_DEBUG(TLVL_WORK_STEPS) << "Allocating CMEM buffer " << m_card_id_str << " numa:" << std::to_string(numa);
+  int handle;
+  u_long cmem_paddr = 0; // NOLINT
+  u_long cmem_vaddr = 0; // NOLINT
+  unsigned ret = CMEM_Open(); // cmem_rcc.h
+  if (!ret) {
+    ret = CMEM_NumaSegmentAllocate(bsize, numa, const_cast<char*>(m_card_id_str.c_str()), &handle); // NUMA aware
+    // ret = CMEM_GFPBPASegmentAllocate(bsize, const_cast<char*>(m_card_id_str.c_str()), &handle); // non NUMA aware
+  }
+  if (!ret) {
+    ret = CMEM_SegmentPhysicalAddress(handle, &cmem_paddr);
+  }
+  if (!ret) {
+    ret = CMEM_SegmentVirtualAddress(handle, &cmem_vaddr);
+  }
+  if (ret) {
+    // rcc_error_print(stdout, ret);
+    m_card_mutex.lock();
+    m_flx_card->card_close();
+    m_card_mutex.unlock();
+    ers::fatal(
+      flxlibs::CardError(ERS_HERE,
+                         "Not enough CMEM memory allocated or the application demands too much CMEM memory.\n"
+                         "Fix the CMEM memory reservation in the driver or change the module's configuration."));
+    exit(EXIT_FAILURE);
+  }
+  *paddr = cmem_paddr;
+  *vaddr = cmem_vaddr;
+  return handle;
+}
+
+void
+FlxCardDMASource::init_DMA(const std::vector<uint8_t>& dma_ids, bool interrupt_mode) // NOLINT
+{
+  TLOG_DEBUG(TLVL_WORK_STEPS) << "InitDMA issued...";
+  m_card_mutex.lock();
+  m_flx_card->dma_reset();
+  TLOG_DEBUG(TLVL_WORK_STEPS) << "flxCard.dma_reset issued.";
+  m_flx_card->soft_reset();
+  TLOG_DEBUG(TLVL_WORK_STEPS) << "flxCard.soft_reset issued.";
+  m_flx_card->irq_reset_counters();
+  TLOG_DEBUG(TLVL_WORK_STEPS) << "flxCard.irq_reset_counters issued.";
+  // interrupted or polled DMA processing
+  if (interrupt_mode) {
+#if REGMAP_VERSION < 0x500
+    m_flx_card->irq_enable(IRQ_DATA_AVAILABLE);
+#else
+    for (auto dma_id : dma_ids) {
+      m_flx_card->irq_enable(IRQ_DATA_AVAILABLE + dma_id);
+    }
+#endif
+    TLOG_DEBUG(TLVL_WORK_STEPS) << "flxCard.irq_enable issued.";
+  } else {
+    m_flx_card->irq_disable();
+    TLOG_DEBUG(TLVL_WORK_STEPS) << "flxCard.irq_disable issued.";
+  }
+  m_card_mutex.unlock();
+}
+
+void
+FlxCardDMASource::start_DMA(uint8_t dma_id, uint64_t paddr, std::size_t bsize) // NOLINT
+{
+  TLOG_DEBUG(TLVL_WORK_STEPS) << "Issuing flxCard.dma_to_host for card " << m_card_id_str
+                              << " dma id:" << std::to_string(dma_id);
+  m_card_mutex.lock();
+  m_flx_card->dma_to_host(dma_id, paddr, bsize, m_dma_wraparound); // FlxCard.h
+  m_card_mutex.unlock();
+}
+
+void
+FlxCardDMASource::stop_DMA(uint8_t dma_id) // NOLINT
+{
+  TLOG_DEBUG(TLVL_WORK_STEPS) << "Issuing flxCard.dma_stop for card " << m_card_id_str
+                              << " dma id:" << std::to_string(dma_id);
+  m_card_mutex.lock();
+  m_flx_card->dma_stop(dma_id);
+  m_card_mutex.unlock();
+}
+
+// The DMA hot path below doesn't take the card mutex: the current address is a single 64 bit read of the
+// descriptor's status register, the read pointer a single 64 bit write of the descriptor's register, and both
+// registers are only touched by the DMA processor of the descriptor. The mutex serializes configuration only.
+
+uint64_t // NOLINT
+FlxCardDMASource::read_current_address(uint8_t dma_id) // NOLINT
+{
+  return m_flx_card->m_bar0->DMA_DESC_STATUS[dma_id].current_address;
+}
+
+void
+FlxCardDMASource::set_read_pointer(uint8_t dma_id, uint64_t paddr) // NOLINT
+{
+  m_flx_card->dma_set_ptr(dma_id, paddr);
+}
+
+void
+FlxCardDMASource::wait_for_data(uint8_t dma_id) // NOLINT
+{
+  // Blocks in the driver until the interrupt arrives, so it must not hold the card mutex.
+#if REGMAP_VERSION < 0x500
+  m_flx_card->irq_wait(IRQ_DATA_AVAILABLE);
+#else
+  m_flx_card->irq_wait(IRQ_DATA_AVAILABLE + dma_id);
+#endif // REGMAP_VERSION
+}
+
+void
+FlxCardDMASource::cancel_wait(uint8_t dma_id) // NOLINT
+{
+#if REGMAP_VERSION < 0x500
+  m_flx_card->irq_cancel(IRQ_DATA_AVAILABLE);
+#else
+  m_flx_card->irq_cancel(IRQ_DATA_AVAILABLE + dma_id);
+#endif // REGMAP_VERSION
+}
+
+} // namespace flxlibs
+} // namespace dunedaq
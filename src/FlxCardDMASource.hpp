@@ -0,0 +1,61 @@
+/**
+ * @file FlxCardDMASource.hpp DMASource backed by FELIX's FlxCard and CMEM_RCC
+ *
+ * This is part of the DUNE DAQ , copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef FLXLIBS_SRC_FLXCARDDMASOURCE_HPP_
+#define FLXLIBS_SRC_FLXCARDDMASOURCE_HPP_
+
+#include "DMASource.hpp"
+
+#include "flxcard/FlxCard.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dunedaq::flxlibs {
+
+class FlxCardDMASource : public DMASource
+{
+public:
+  /**
+   * @brief FlxCardDMASource Constructor
+   * @param card_id Physical card identifier
+   * @param logical_unit Superlogic region of the card
+   * @param id_str Card identifier string, used for logging and as CMEM segment name
+   */
+  FlxCardDMASource(uint8_t card_id, uint8_t logical_unit, const std::string& id_str); // NOLINT
+
+  void open_card(const std::vector<uint8_t>& dma_ids) override; // NOLINT
+  void close_card() override;
+  int allocate_buffer(uint8_t numa, std::size_t bsize, uint64_t* paddr, uint64_t* vaddr) override; // NOLINT
+
+  void init_DMA(const std::vector<uint8_t>& dma_ids, bool interrupt_mode) override; // NOLINT
+  void start_DMA(uint8_t dma_id, uint64_t paddr, std::size_t bsize) override;      // NOLINT
+  void stop_DMA(uint8_t dma_id) override;                                          // NOLINT
+  uint64_t read_current_address(uint8_t dma_id) override;                          // NOLINT
+  void set_read_pointer(uint8_t dma_id, uint64_t paddr) override;                  // NOLINT
+  void wait_for_data(uint8_t dma_id) override;                                     // NOLINT
+  void cancel_wait(uint8_t dma_id) override;                                       // NOLINT
+
+private:
+  // Constants
+  static constexpr size_t m_dma_wraparound = FLX_DMA_WRAPAROUND;
+
+  uint8_t m_card_id;      // NOLINT
+  uint8_t m_logical_unit; // NOLINT
+  std::string m_card_id_str;
+
+  // Card object
+  using UniqueFlxCard = std::unique_ptr<FlxCard>;
+  UniqueFlxCard m_flx_card;
+  std::mutex m_card_mutex; // serializes configuration, not taken on the DMA hot path
+};
+
+} // namespace dunedaq::flxlibs
+
+#endif // FLXLIBS_SRC_FLXCARDDMASOURCE_HPP_
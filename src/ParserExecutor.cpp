@@ -0,0 +1,223 @@
+/**
+ * @file ParserExecutor.cpp Shared pool of elink parser workers implementation
+ *
+ * This is part of the DUNE DAQ , copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+// From Module
+#include "ParserExecutor.hpp"
+#include "ElinkConcept.hpp"
+#include "ThreadAffinity.hpp"
+
+#include "logging/Logging.hpp"
+
+// From STD
+#include <chrono>
+#include <string>
+#include <thread>
+#include <utility>
+
+/**
+ * @brief TRACE debug levels used in this source file
+ */
+enum
+{
+  TLVL_ENTER_EXIT_METHODS = 5,
+  TLVL_WORK_STEPS = 10,
+  TLVL_BOOKKEEPING = 15
+};
+
+namespace dunedaq {
+namespace flxlibs {
+
+ParserExecutor::ParserExecutor(const std::string& name,
+                               std::size_t num_workers,
+                               const std::vector<int>& cpus,
+                               std::size_t spin_count)
+  : m_name(name)
+  , m_spin_count(spin_count)
+{
+  check_cpu_range(cpus, m_name);
+  for (std::size_t i = 0; i < num_workers; ++i) {
+    auto worker = std::make_unique<Worker>();
+    worker->id = i;
+    worker->name = m_name + "-" + std::to_string(i);
+    worker->thread.set_name(m_name, i);
+    if (!cpus.empty()) {
+      worker->cpus = { cpus[i % cpus.size()] };
+    }
+    m_workers.push_back(std::move(worker));
+  }
+}
+
+ParserExecutor::~ParserExecutor()
+{
+  stop();
+}
+
+void
+ParserExecutor::attach(ElinkConcept* elink)
+{
+  elink->set_executor(this, m_next_home);
+  m_workers[m_next_home]->elinks.push_back(elink);
+  m_next_home = (m_next_home + 1) % m_workers.size();
+}
+
+void
+ParserExecutor::start()
+{
+  if (m_run_marker.exchange(true)) {
+    return;
+  }
+  for (auto& worker : m_workers) {
+    worker->parker.reset();
+    worker->thread.set_work(&ParserExecutor::run, this, worker.get());
+  }
+  TLOG_DEBUG(TLVL_WORK_STEPS) << "Started " << m_workers.size() << " parser workers of " << m_name;
+}
+
+void
+ParserExecutor::stop()
+{
+  if (!m_run_marker.exchange(false)) {
+    return;
+  }
+  for (auto& worker : m_workers) {
+    worker->parker.interrupt();
+  }
+  for (auto& worker : m_workers) {
+    // The thread becomes ready as soon as the worker drained the deques and returned
+    while (!worker->thread.get_readiness()) {
+      std::this_thread::yield();
+    }
+    TLOG_DEBUG(TLVL_BOOKKEEPING) << worker->name << " parsed " << worker->num_batches << " batches, "
+                                 << worker->num_steals << " of them stolen.";
+    worker->num_batches = 0;
+    worker->num_steals = 0;
+  }
+}
+
+void
+ParserExecutor::notify(ElinkConcept* elink)
+{
+  if (elink->try_schedule()) {
+    auto& home = *m_workers[elink->get_home_worker()];
+    // Workers only park while no elink is pending, and recheck m_pending once parked: unpark after every push.
+    // A busy worker always comes back to its deque and steals before parking, so any awake worker gets the elink.
+    push(home, elink);
+    if (!home.busy.load(std::memory_order_relaxed)) {
+      home.parker.unpark();
+    } else {
+      // The home worker is busy: wake up its neighbour to steal the elink
+      m_workers[(home.id + 1) % m_workers.size()]->parker.unpark();
+    }
+  }
+}
+
+void
+ParserExecutor::push(Worker& worker, ElinkConcept* elink)
+{
+  std::lock_guard<std::mutex> lk(worker.deque_mutex);
+  worker.tasks.push_back(elink);
+  m_pending.fetch_add(1, std::memory_order_relaxed);
+}
+
+ElinkConcept*
+ParserExecutor::pop(Worker& worker)
+{
+  std::lock_guard<std::mutex> lk(worker.deque_mutex);
+  if (worker.tasks.empty()) {
+    return nullptr;
+  }
+  auto* elink = worker.tasks.front();
+  worker.tasks.pop_front();
+  m_pending.fetch_sub(1, std::memory_order_relaxed);
+  return elink;
+}
+
+ElinkConcept*
+ParserExecutor::steal(Worker& thief)
+{
+  // Steal from the back: the elink that waited the least on its home worker
+  for (std::size_t i = 1; i < m_workers.size(); ++i) {
+    auto& victim = *m_workers[(thief.id + i) % m_workers.size()];
+    std::lock_guard<std::mutex> lk(victim.deque_mutex);
+    if (!victim.tasks.empty()) {
+      auto* elink = victim.tasks.back();
+      victim.tasks.pop_back();
+      m_pending.fetch_sub(1, std::memory_order_relaxed);
+      ++thief.num_steals;
+      return elink;
+    }
+  }
+  return nullptr;
+}
+
+void
+ParserExecutor::release_stale_chunks(Worker& worker)
+{
+  // Scheduling an elink makes the worker its only parser, as for a batch
+  worker.batches_since_stale_check = 0;
+  for (auto* elink : worker.elinks) {
+    if (elink->try_schedule()) {
+      elink->release_stale_chunk();
+      elink->unschedule();
+      if (elink->has_blocks() && elink->try_schedule()) { // raced with the router
+        push(worker, elink);
+      }
+    }
+  }
+}
+
+void
+ParserExecutor::run(Worker* worker_ptr)
+{
+  auto& worker = *worker_ptr;
+  pin_current_thread(worker.cpus, worker.name);
+  std::size_t idle_spins = 0;
+  while (true) {
+    auto* elink = pop(worker);
+    if (elink == nullptr) {
+      elink = steal(worker);
+    }
+    if (elink == nullptr) {
+      // Stopped, and nothing left to parse: the producers are stopped before the executor
+      if (!m_run_marker.load()) {
+        break;
+      }
+      if (idle_spins < m_spin_count) {
+        cpu_relax();
+        ++idle_spins;
+      } else {
+        // Any pending elink wakes the worker up, to steal it if it isn't in its own deque. The timeout is a bound.
+        worker.parker.park([&]() { return m_pending.load(std::memory_order_relaxed) > 0; },
+                           std::chrono::microseconds(1000));
+        release_stale_chunks(worker);
+        idle_spins = 0;
+      }
+      continue;
+    }
+
+    idle_spins = 0;
+    worker.busy.store(true, std::memory_order_relaxed);
+    elink->parse_batch();
+    ++worker.num_batches;
+    if (++worker.batches_since_stale_check == s_stale_check_batches) {
+      release_stale_chunks(worker);
+    }
+    // Round robin between the elinks with blocks, keeping the elink scheduled while it has some
+    if (elink->has_blocks()) {
+      push(worker, elink);
+    } else {
+      elink->unschedule();
+      if (elink->has_blocks() && elink->try_schedule()) { // raced with the router
+        push(worker, elink);
+      }
+    }
+    worker.busy.store(false, std::memory_order_relaxed);
+  }
+}
+
+} // namespace flxlibs
+} // namespace dunedaq
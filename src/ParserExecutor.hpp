@@ -0,0 +1,91 @@
+/**
+ * @file ParserExecutor.hpp Shared pool of elink parser workers. Elinks with
+ * queued blocks are scheduled as tasks on per-worker deques: a worker parses a
+ * batch of blocks of its elink, re-queues it if there is more, and steals
+ * elinks from the other workers when its own deque is empty.
+ *
+ * This is part of the DUNE DAQ , copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef FLXLIBS_SRC_PARSEREXECUTOR_HPP_
+#define FLXLIBS_SRC_PARSEREXECUTOR_HPP_
+
+#include "WaitStrategy.hpp"
+
+#include "utilities/ReusableThread.hpp"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dunedaq::flxlibs {
+
+class ElinkConcept;
+
+class ParserExecutor
+{
+public:
+  /**
+   * @brief ParserExecutor Constructor
+   * @param name Prefix of the worker thread names
+   * @param num_workers Number of worker threads
+   * @param cpus CPU set of the workers: worker i is pinned to cpus[i % size], empty for no pinning
+   * @param spin_count Number of polls of empty deques before a worker parks
+   */
+  ParserExecutor(const std::string& name, std::size_t num_workers, const std::vector<int>& cpus, std::size_t spin_count);
+  ~ParserExecutor();
+  ParserExecutor(const ParserExecutor&) = delete;            ///< ParserExecutor is not copy-constructible
+  ParserExecutor& operator=(const ParserExecutor&) = delete; ///< ParserExecutor is not copy-assignable
+  ParserExecutor(ParserExecutor&&) = delete;                 ///< ParserExecutor is not move-constructible
+  ParserExecutor& operator=(ParserExecutor&&) = delete;      ///< ParserExecutor is not move-assignable
+
+  // Assigns the home worker of an elink, which also drops its stale chunks while idle. To be called before start.
+  void attach(ElinkConcept* elink);
+
+  void start();
+  // Returns once every queued block was parsed. The producers have to be stopped first.
+  void stop();
+
+  // Called by the router after queueing blocks of an elink: schedules it, unless it is already.
+  void notify(ElinkConcept* elink);
+
+private:
+  struct Worker
+  {
+    std::size_t id{ 0 };
+    std::string name;
+    std::vector<int> cpus;
+    std::mutex deque_mutex;
+    std::deque<ElinkConcept*> tasks;
+    std::vector<ElinkConcept*> elinks; // of which it is the home worker
+    std::atomic<bool> busy{ false };
+    Parker parker;
+    utilities::ReusableThread thread{ 0 };
+    uint64_t num_batches{ 0 }; // NOLINT(build/unsigned)
+    uint64_t num_steals{ 0 };  // NOLINT(build/unsigned)
+    std::size_t batches_since_stale_check{ 0 };
+  };
+
+  static constexpr std::size_t s_stale_check_batches = 1024; // a worker that never idles checks this often
+
+  void push(Worker& worker, ElinkConcept* elink);
+  ElinkConcept* pop(Worker& worker);
+  ElinkConcept* steal(Worker& thief);
+  void release_stale_chunks(Worker& worker);
+  void run(Worker* worker);
+
+  std::string m_name;
+  std::size_t m_spin_count;
+  std::atomic<bool> m_run_marker{ false };
+  std::atomic<std::size_t> m_pending{ 0 }; // elinks in the deques of all the workers
+  std::vector<std::unique_ptr<Worker>> m_workers;
+  std::size_t m_next_home{ 0 };
+};
+
+} // namespace dunedaq::flxlibs
+
+#endif // FLXLIBS_SRC_PARSEREXECUTOR_HPP_
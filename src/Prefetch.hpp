@@ -0,0 +1,36 @@
+/**
+ * @file Prefetch.hpp Software prefetch of freshly DMA-d blocks. The card writes
+ * blocks behind the caches' back, so the first touch of every block is a miss.
+ *
+ * This is part of the DUNE DAQ , copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef FLXLIBS_SRC_PREFETCH_HPP_
+#define FLXLIBS_SRC_PREFETCH_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dunedaq::flxlibs {
+
+static constexpr std::size_t cache_line_size = 64;
+
+// Header of a block: elink, sequence number and start of block marker.
+inline void
+prefetch_block_header(uint64_t block_addr) // NOLINT(build/unsigned)
+{
+  __builtin_prefetch(reinterpret_cast<const void*>(block_addr), 0, 3); // NOLINT
+}
+
+// Both ends of a block: the parser reads the header, then walks the subchunk trailers from the end.
+inline void
+prefetch_block(uint64_t block_addr, std::size_t block_size) // NOLINT(build/unsigned)
+{
+  __builtin_prefetch(reinterpret_cast<const void*>(block_addr), 0, 3);                                  // NOLINT
+  __builtin_prefetch(reinterpret_cast<const void*>(block_addr + block_size - cache_line_size), 0, 3); // NOLINT
+}
+
+} // namespace dunedaq::flxlibs
+
+#endif // FLXLIBS_SRC_PREFETCH_HPP_
@@ -0,0 +1,182 @@
+/**
+ * @file StaticParserImpl.hpp FELIX's packetformat block/chunk parser with the
+ * chunk operations resolved at compile time. Unlike DefaultParserImpl, no
+ * std::function sits between the BlockParser and the copy into the payload.
+ *
+ * This is part of the DUNE DAQ , copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef FLXLIBS_SRC_STATICPARSERIMPL_HPP_
+#define FLXLIBS_SRC_STATICPARSERIMPL_HPP_
+
+// 3rdparty, external
+#include "packetformat/block_format.hpp"
+#include "packetformat/block_parser.hpp"
+
+#include "FelixStatistics.hpp"
+#include "flxlibs/ReservableSender.hpp"
+
+#include "iomanager/Sender.hpp"
+
+// From STD
+#include <chrono>
+#include <memory>
+#include <type_traits>
+
+namespace dunedaq::flxlibs {
+
+/**
+ * @brief SinkPolicy provides static chunk(chunk, sink, reservable_sink, payload_pool, timeout, streaming_threshold)
+ * and shortchunk(shortchunk, sink, reservable_sink, payload_pool, timeout) operations for TargetPayloadType,
+ * returning false when they drop a payload on a full sink, and the payload_pool_t of their payloads, void if they
+ * have none. See the policies in AvailableParserOperations.hpp.
+ * The class is final, so the BlockParser's calls to the ParserOperations are not virtual.
+ */
+template<class TargetPayloadType, class SinkPolicy>
+class StaticParserImpl final : public felix::packetformat::ParserOperations
+{
+public:
+  using sink_t = iomanager::SenderConcept<TargetPayloadType>;
+  using payload_pool_t = typename SinkPolicy::template payload_pool_t<TargetPayloadType>;
+  static constexpr bool uses_payload_pool = !std::is_void_v<payload_pool_t>;
+
+  StaticParserImpl() = default;
+  StaticParserImpl(const StaticParserImpl&) = delete;            ///< StaticParserImpl is not copy-constructible
+  StaticParserImpl& operator=(const StaticParserImpl&) = delete; ///< StaticParserImpl is not copy-assignable
+  StaticParserImpl(StaticParserImpl&&) = delete;                 ///< StaticParserImpl is not move-constructible
+  StaticParserImpl& operator=(StaticParserImpl&&) = delete;      ///< StaticParserImpl is not move-assignable
+
+  // The sink is owned by the ElinkModel, and must be set before parsing.
+  // Payloads are assembled in place if the sink is a ReservableSender.
+  void set_sink(std::shared_ptr<sink_t>& sink, std::chrono::milliseconds timeout = std::chrono::milliseconds(100))
+  {
+    m_sink = &sink;
+    m_reservable_sink = dynamic_cast<ReservableSender<TargetPayloadType>*>(sink.get());
+    m_timeout = timeout;
+  }
+
+  // Time to wait for room in a full sink before dropping a payload, 0 to drop right away.
+  void set_send_timeout(std::chrono::milliseconds timeout) { m_timeout = timeout; }
+
+  // Chunks of at least this many bytes are copied into their payload with non-temporal stores, 0 never.
+  void set_streaming_copy_threshold(std::size_t threshold) { m_streaming_copy_threshold = threshold; }
+
+  static std::shared_ptr<payload_pool_t> create_payload_pool(std::size_t capacity, std::size_t max_payload_size)
+  {
+    return SinkPolicy::template create_payload_pool<TargetPayloadType>(capacity, max_payload_size);
+  }
+
+  // The pool is owned by the ElinkModel, and must be set before parsing if the SinkPolicy uses one.
+  void set_payload_pool(payload_pool_t* payload_pool) { m_payload_pool = payload_pool; }
+
+  stats::ParserStats& get_stats() { return m_stats; }
+  void publish_stats() { stats::publish(m_counters, m_stats); }
+
+  // Also count the bytes and the size distribution of the chunks
+  void set_detailed_stats(bool detailed_stats) { m_detailed_stats = detailed_stats; }
+
+  // Histogram of the time to copy and send every chunk, nullptr to not measure it
+  void set_sink_latency(stats::LatencyHistogram* sink_latency) { m_sink_latency = sink_latency; }
+
+  // Number of chunks that ended, delivered or not, and whether the BlockParser is assembling one: it then holds
+  // pointers into the blocks since the one the chunk started in.
+  uint64_t get_chunk_boundaries() const { return m_chunk_boundaries; } // NOLINT(build/unsigned)
+  bool has_open_chunk() const { return m_open_chunk; }
+  // The open chunk is given up on, with the BlockParser that was assembling it
+  void discard_open_chunk() { end_chunk(); }
+
+  // Implementation of ParserOperations
+  void chunk_processed(const felix::packetformat::chunk& chunk) override
+  {
+    uint64_t t_sink = m_sink_latency != nullptr ? stats::steady_clock_ns() : 0; // NOLINT(build/unsigned)
+    if (!SinkPolicy::chunk(
+          chunk, *m_sink, m_reservable_sink, m_payload_pool, m_timeout, m_streaming_copy_threshold)) {
+      m_counters.dropped_payload_ctr++;
+    }
+    if (m_sink_latency != nullptr) {
+      m_sink_latency->record(stats::steady_clock_ns() - t_sink);
+    }
+    m_counters.chunk_ctr++;
+    if (m_detailed_stats) {
+      stats::count_chunk_size(m_counters, chunk.length());
+    }
+    end_chunk();
+  }
+  void shortchunk_processed(const felix::packetformat::shortchunk& shortchunk) override
+  {
+    uint64_t t_sink = m_sink_latency != nullptr ? stats::steady_clock_ns() : 0; // NOLINT(build/unsigned)
+    if (!SinkPolicy::shortchunk(shortchunk, *m_sink, m_reservable_sink, m_payload_pool, m_timeout)) {
+      m_counters.dropped_payload_ctr++;
+    }
+    if (m_sink_latency != nullptr) {
+      m_sink_latency->record(stats::steady_clock_ns() - t_sink);
+    }
+    m_counters.short_ctr++;
+    if (m_detailed_stats) {
+      stats::count_chunk_size(m_counters, shortchunk.length);
+    }
+    end_chunk();
+  }
+  void subchunk_processed(const felix::packetformat::subchunk& /*subchunk*/) override
+  {
+    m_counters.subchunk_ctr++;
+    m_open_chunk = true;
+  }
+  void block_processed(const felix::packetformat::block& /*block*/) override { m_counters.block_ctr++; }
+  void chunk_processed_with_error(const felix::packetformat::chunk& /*chunk*/) override
+  {
+    m_counters.error_chunk_ctr++;
+    end_chunk();
+  }
+  void subchunk_processed_with_error(const felix::packetformat::subchunk& subchunk) override
+  {
+    if (subchunk.crcerr_flag) { // NOLINT(runtime/output_format)
+      m_counters.subchunk_crc_error_ctr++;
+    }
+    if (subchunk.trunc_flag) {
+      m_counters.subchunk_trunc_error_ctr++;
+    }
+    if (subchunk.err_flag) {
+      m_counters.subchunk_error_ctr++;
+    }
+    m_counters.error_subchunk_ctr++;
+    m_open_chunk = true;
+  }
+  void shortchunk_process_with_error(const felix::packetformat::shortchunk& /*shortchunk*/) override
+  {
+    m_counters.error_short_ctr++;
+    end_chunk();
+  }
+  void block_processed_with_error(const felix::packetformat::block& /*block*/) override
+  {
+    m_counters.error_block_ctr++;
+  }
+
+private:
+  void end_chunk()
+  {
+    ++m_chunk_boundaries;
+    m_open_chunk = false;
+  }
+
+  std::shared_ptr<sink_t>* m_sink{ nullptr };
+  ReservableSender<TargetPayloadType>* m_reservable_sink{ nullptr };
+  payload_pool_t* m_payload_pool{ nullptr };
+  std::chrono::milliseconds m_timeout{ 100 };
+  std::size_t m_streaming_copy_threshold{ 0 };
+
+  // Chunk boundaries
+  uint64_t m_chunk_boundaries{ 0 }; // NOLINT(build/unsigned)
+  bool m_open_chunk{ false };
+
+  // Statistics
+  bool m_detailed_stats{ false };
+  stats::LatencyHistogram* m_sink_latency{ nullptr };
+  stats::ParserCounters m_counters;
+  stats::ParserStats m_stats;
+};
+
+} // namespace dunedaq::flxlibs
+
+#endif // FLXLIBS_SRC_STATICPARSERIMPL_HPP_
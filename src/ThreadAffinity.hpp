@@ -0,0 +1,99 @@
+/**
+ * @file ThreadAffinity.hpp CPU pinning of readout threads, and its validation
+ * against the NUMA node of the DMA memory.
+ *
+ * This is part of the DUNE DAQ , copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef FLXLIBS_SRC_THREADAFFINITY_HPP_
+#define FLXLIBS_SRC_THREADAFFINITY_HPP_
+
+#include "FelixIssues.hpp"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace dunedaq::flxlibs {
+
+// Returns the NUMA node of a CPU from sysfs, -1 if unknown.
+inline int
+numa_node_of_cpu(int cpu)
+{
+  std::error_code ec;
+  std::filesystem::directory_iterator cpu_dir("/sys/devices/system/cpu/cpu" + std::to_string(cpu), ec);
+  if (ec) {
+    return -1;
+  }
+  for (const auto& entry : cpu_dir) {
+    auto name = entry.path().filename().string();
+    if (name.rfind("node", 0) == 0) {
+      return std::stoi(name.substr(4));
+    }
+  }
+  return -1;
+}
+
+// True if the CPU fits a cpu_set_t
+inline bool
+is_valid_cpu(int cpu)
+{
+  return cpu >= 0 && cpu < CPU_SETSIZE;
+}
+
+// Rejects CPU sets with CPUs that don't fit a cpu_set_t.
+inline void
+check_cpu_range(const std::vector<int>& cpus, const std::string& thread_name)
+{
+  for (auto cpu : cpus) {
+    if (!is_valid_cpu(cpu)) {
+      throw ConfigurationError(ERS_HERE,
+                               "CPU " + std::to_string(cpu) + " of " + thread_name + " is out of the range of CPU sets");
+    }
+  }
+}
+
+// Rejects CPUs out of range, and warns about every CPU of the set that is not on the NUMA node of the DMA memory.
+inline void
+validate_cpu_affinity(const std::vector<int>& cpus, int numa_id, const std::string& thread_name)
+{
+  check_cpu_range(cpus, thread_name);
+  for (auto cpu : cpus) {
+    auto cpu_node = numa_node_of_cpu(cpu);
+    if (cpu_node >= 0 && cpu_node != numa_id) {
+      ers::warning(ThreadNUMAMismatch(ERS_HERE, thread_name, cpu, cpu_node, numa_id));
+    }
+  }
+}
+
+// Pins the calling thread to the CPU set. An empty set leaves the affinity untouched. CPUs out of range were
+// rejected at configuration: should one get here, the thread is left unpinned.
+inline void
+pin_current_thread(const std::vector<int>& cpus, const std::string& thread_name)
+{
+  if (cpus.empty()) {
+    return;
+  }
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  for (auto cpu : cpus) {
+    if (!is_valid_cpu(cpu)) {
+      ers::error(ConfigurationError(ERS_HERE,
+                                    "CPU " + std::to_string(cpu) + " of " + thread_name + " is out of the range of CPU sets"));
+      return;
+    }
+    CPU_SET(cpu, &cpuset);
+  }
+  int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+  if (ret != 0) {
+    ers::warning(ThreadAffinityError(ERS_HERE, thread_name, ret));
+  }
+}
+
+} // namespace dunedaq::flxlibs
+
+#endif // FLXLIBS_SRC_THREADAFFINITY_HPP_
@@ -0,0 +1,219 @@
+/**
+ * @file WaitStrategy.hpp Wait strategies for threads polling for new data.
+ * The waiter trades CPU for latency: busy spinning, spinning then yielding,
+ * plain sleeping, or an exponential backoff that adapts to the observed fill rate.
+ *
+ * This is part of the DUNE DAQ , copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#ifndef FLXLIBS_SRC_WAITSTRATEGY_HPP_
+#define FLXLIBS_SRC_WAITSTRATEGY_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace dunedaq::flxlibs {
+
+enum class WaitStrategy
+{
+  kSleep,     // fixed sleep of the max. wait time (legacy poll mode)
+  kBusySpin,  // spin with pause, never gives up the core
+  kSpinYield, // spin for a budget of iterations, then yield
+  kBackoff,   // exponential backoff, adapted to the observed fill rate
+  kInterrupt  // wait for device interrupts (handled by the owner), backoff otherwise
+};
+
+inline void
+cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
+// A sleep that can be cut short from another thread, e.g.: on stop. Stays interrupted until reset.
+class InterruptibleSleep
+{
+public:
+  template<class Rep, class Period>
+  void sleep_for(const std::chrono::duration<Rep, Period>& duration)
+  {
+    std::unique_lock<std::mutex> lk(m_mutex);
+    m_cv.wait_for(lk, duration, [this]() { return m_interrupted; });
+  }
+
+  void interrupt()
+  {
+    {
+      std::lock_guard<std::mutex> lk(m_mutex);
+      m_interrupted = true;
+    }
+    m_cv.notify_all();
+  }
+
+  void reset()
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_interrupted = false;
+  }
+
+private:
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  bool m_interrupted{ false };
+};
+
+// Lets a consumer thread park until a producer signals new data. The producer only pays for a fence and a
+// load while the consumer is running. Stays interrupted until reset, like InterruptibleSleep.
+// No wake-up is lost, as long as the producer calls unpark after every publication: the consumer publishes
+// m_parked and then rechecks ready(), the producer publishes its data and then checks m_parked, with a
+// seq_cst fence in between on both sides. The timeout of park is only a bound, not part of the protocol.
+class Parker
+{
+public:
+  // Consumer side: parks until ready() holds, interrupted, or the timeout expires.
+  template<class Ready>
+  void park(Ready ready, std::chrono::microseconds timeout)
+  {
+    std::unique_lock<std::mutex> lk(m_mutex);
+    m_parked.store(true, std::memory_order_relaxed);
+    // Pairs with the fence of unpark: either the producer sees m_parked, or the recheck of ready() by wait_for
+    // sees the new data
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    m_cv.wait_for(lk, timeout, [&]() { return m_interrupted || ready(); });
+    m_parked.store(false, std::memory_order_relaxed);
+  }
+
+  // Producer side, after publishing new data, every time.
+  void unpark()
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_parked.load(std::memory_order_relaxed)) {
+      {
+        std::lock_guard<std::mutex> lk(m_mutex); // the consumer is either waiting, or yet to check ready()
+      }
+      m_cv.notify_one();
+    }
+  }
+
+  void interrupt()
+  {
+    {
+      std::lock_guard<std::mutex> lk(m_mutex);
+      m_interrupted = true;
+    }
+    m_cv.notify_all();
+  }
+
+  void reset()
+  {
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_interrupted = false;
+  }
+
+private:
+  std::atomic<bool> m_parked{ false };
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  bool m_interrupted{ false };
+};
+
+class Waiter
+{
+public:
+  using clock_t = std::chrono::steady_clock;
+
+  void configure(WaitStrategy strategy, std::chrono::microseconds max_wait, std::size_t spin_count)
+  {
+    m_strategy = strategy;
+    m_max_wait = std::max(max_wait, m_min_wait);
+    m_spin_count = spin_count;
+    reset();
+  }
+
+  WaitStrategy get_strategy() const { return m_strategy; }
+
+  void reset()
+  {
+    m_sleep.reset();
+    m_backoff = m_min_wait;
+    m_bytes_per_us = 0;
+    m_last_observed = clock_t::now();
+  }
+
+  // Wakes up a sleeping wait, and makes further sleeps return immediately until reset.
+  void interrupt() { m_sleep.interrupt(); }
+
+  // Records that bytes of new data were consumed, updating the fill rate estimate.
+  void observe(uint64_t bytes) // NOLINT(build/unsigned)
+  {
+    auto now = clock_t::now();
+    double elapsed_us = std::chrono::duration<double, std::micro>(now - m_last_observed).count();
+    if (elapsed_us > 0) {
+      double rate = bytes / elapsed_us;
+      m_bytes_per_us = (m_bytes_per_us == 0) ? rate : m_rate_smoothing * rate + (1 - m_rate_smoothing) * m_bytes_per_us;
+    }
+    m_last_observed = now;
+    m_backoff = m_min_wait;
+  }
+
+  // Waits once, while bytes_available is below bytes_needed.
+  void wait(uint64_t bytes_available, uint64_t bytes_needed) // NOLINT(build/unsigned)
+  {
+    switch (m_strategy) {
+      case WaitStrategy::kSleep:
+        m_sleep.sleep_for(m_max_wait);
+        break;
+      case WaitStrategy::kBusySpin:
+        cpu_relax();
+        break;
+      case WaitStrategy::kSpinYield:
+        for (std::size_t i = 0; i < m_spin_count; ++i) {
+          cpu_relax();
+        }
+        std::this_thread::yield();
+        break;
+      case WaitStrategy::kBackoff:
+      case WaitStrategy::kInterrupt:
+        m_sleep.sleep_for(next_backoff(bytes_available, bytes_needed));
+        break;
+    }
+  }
+
+private:
+  std::chrono::microseconds next_backoff(uint64_t bytes_available, uint64_t bytes_needed) // NOLINT(build/unsigned)
+  {
+    // With a known fill rate, sleep for half of the predicted time until enough data is there.
+    // Back off exponentially if the data doesn't arrive as predicted. Bound to [min, max] wait.
+    std::chrono::microseconds wait = m_backoff;
+    if (m_bytes_per_us > 0 && bytes_needed > bytes_available) {
+      auto predicted = static_cast<int64_t>((bytes_needed - bytes_available) / m_bytes_per_us / 2);
+      wait = std::max(wait, std::chrono::microseconds(predicted));
+    }
+    m_backoff = std::min(m_backoff * 2, m_max_wait);
+    return std::clamp(wait, m_min_wait, m_max_wait);
+  }
+
+  static constexpr std::chrono::microseconds m_min_wait{ 1 };
+  static constexpr double m_rate_smoothing = 0.2;
+
+  WaitStrategy m_strategy{ WaitStrategy::kBackoff };
+  std::chrono::microseconds m_max_wait{ 5000 };
+  std::size_t m_spin_count{ 1000 };
+  std::chrono::microseconds m_backoff{ m_min_wait };
+  double m_bytes_per_us{ 0 };
+  clock_t::time_point m_last_observed{ clock_t::now() };
+  InterruptibleSleep m_sleep;
+};
+
+} // namespace dunedaq::flxlibs
+
+#endif // FLXLIBS_SRC_WAITSTRATEGY_HPP_
@@ -0,0 +1,126 @@
+/**
+ * @file test_chunk_copy_app.cxx Microbenchmark of the chunk copy kernels.
+ * Assembles DAPHNE sized chunks from one, three, and contiguous subchunks,
+ * with the subchunk by subchunk dump_to_buffer loop and with copy_subchunks,
+ * with and without non-temporal stores, and reports the achieved throughput.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "flxlibs/ChunkCopy.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace dunedaq::flxlibs::parsers;
+
+namespace {
+
+constexpr std::size_t chunk_size = 5568; // DAPHNE frame
+constexpr std::size_t max_subchunks = 8;
+
+struct Layout
+{
+  std::string name;
+  std::array<const char*, max_subchunks> data;
+  std::array<std::size_t, max_subchunks> sizes;
+  unsigned n_subchunks;
+};
+
+// Splits a chunk into n subchunks, either back to back, or each one in its own block like chunks spanning blocks
+Layout
+make_layout(const std::string& name, const char* blocks, std::size_t block_size, unsigned n, bool contiguous)
+{
+  Layout layout{ name, {}, {}, n };
+  std::size_t offset = 0;
+  for (unsigned i = 0; i < n; ++i) {
+    std::size_t size = (i == n - 1) ? chunk_size - offset : chunk_size / n;
+    layout.data[i] = contiguous ? blocks + offset : blocks + i * block_size + 64; // skip a block header
+    layout.sizes[i] = size;
+    offset += size;
+  }
+  return layout;
+}
+
+// Returns the throughput in GB/s of the copy into a ring of payloads, larger than the last level cache
+template<class Copy>
+double
+bench(Copy copy, std::vector<char>& payloads, std::size_t iterations)
+{
+  const std::size_t num_payloads = payloads.size() / chunk_size;
+  auto t0 = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < iterations; ++i) {
+    copy(payloads.data() + (i % num_payloads) * chunk_size);
+  }
+  auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  return iterations * chunk_size / seconds / 1e9;
+}
+
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+  std::size_t iterations = (argc > 1) ? std::stoul(argv[1]) : 2000000;
+
+  constexpr std::size_t block_size = 4096;
+  std::vector<char> blocks(max_subchunks * block_size);
+  for (std::size_t i = 0; i < blocks.size(); ++i) {
+    blocks[i] = static_cast<char>(i);
+  }
+  std::vector<char> payloads(64 * 1024 * 1024);
+
+  std::vector<Layout> layouts = { make_layout("1 subchunk", blocks.data(), block_size, 1, true),
+                                  make_layout("3 subchunks", blocks.data(), block_size, 3, false),
+                                  make_layout("3 contiguous", blocks.data(), block_size, 3, true) };
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << std::left << std::setw(16) << "layout" << std::right << std::setw(16) << "dump_to_buffer"
+            << std::setw(16) << "copy_subchunks" << std::setw(16) << "streaming" << "  [GB/s]\n";
+  for (const auto& layout : layouts) {
+    auto legacy = bench(
+      [&](char* payload) {
+        uint32_t bytes_copied_chunk = 0; // NOLINT(build/unsigned)
+        for (unsigned i = 0; i < layout.n_subchunks; ++i) {
+          dump_to_buffer(layout.data[i], layout.sizes[i], payload, bytes_copied_chunk, chunk_size);
+          bytes_copied_chunk += layout.sizes[i];
+        }
+      },
+      payloads,
+      iterations);
+    auto fast = bench(
+      [&](char* payload) { copy_subchunks(payload, chunk_size, layout.data, layout.sizes, layout.n_subchunks, 0); },
+      payloads,
+      iterations);
+    auto streaming = bench(
+      [&](char* payload) { copy_subchunks(payload, chunk_size, layout.data, layout.sizes, layout.n_subchunks, 1); },
+      payloads,
+      iterations);
+    std::cout << std::left << std::setw(16) << layout.name << std::right << std::setw(16) << legacy << std::setw(16)
+              << fast << std::setw(16) << streaming << "\n";
+  }
+
+  // Sanity check of the copies against each other
+  std::vector<char> expected(chunk_size), actual(chunk_size);
+  for (const auto& layout : layouts) {
+    uint32_t bytes_copied_chunk = 0; // NOLINT(build/unsigned)
+    for (unsigned i = 0; i < layout.n_subchunks; ++i) {
+      dump_to_buffer(layout.data[i], layout.sizes[i], expected.data(), bytes_copied_chunk, chunk_size);
+      bytes_copied_chunk += layout.sizes[i];
+    }
+    for (std::size_t threshold : { 0, 1 }) {
+      copy_subchunks(actual.data(), chunk_size, layout.data, layout.sizes, layout.n_subchunks, threshold);
+      if (expected != actual) {
+        std::cerr << "Mismatch of the copies for " << layout.name << "\n";
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,86 @@
+/**
+ * @file test_elink_registry_app.cxx Test application for the lookup order of
+ * ElinkModelRegistry. Registers test data types whose names contain each
+ * other, and checks that an exact name wins over an earlier registered
+ * substring, that otherwise the first registered name contained in the data
+ * type is used, and that an unknown data type creates nothing.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "ElinkModelRegistry.hpp"
+
+#include "logging/Logging.hpp"
+
+#include <memory>
+#include <string>
+
+using namespace dunedaq::flxlibs;
+
+namespace {
+
+// Name of the data type whose factory ran last
+std::string created;
+
+ElinkModelRegistry::factory_t
+factory_of(const std::string& name)
+{
+  return [name](const std::string& /*conn_uid*/) -> std::unique_ptr<ElinkConcept> {
+    created = name;
+    return nullptr;
+  };
+}
+
+// Name of the registered data type the registry creates the ElinkModel of data_type with, empty for none
+std::string
+lookup(const std::string& data_type)
+{
+  created.clear();
+  ElinkModelRegistry::get().create(data_type, "test_conn");
+  return created;
+}
+
+bool
+check(bool condition, const std::string& what)
+{
+  TLOG() << (condition ? "  OK: " : "  FAILED: ") << what;
+  return condition;
+}
+
+} // namespace
+
+int
+main(int /*argc*/, char** /*argv*/)
+{
+  // In registration order: the shorter names first, so that they are contained in the later ones
+  auto& registry = ElinkModelRegistry::get();
+  registry.add("TestFrame", factory_of("TestFrame"));
+  registry.add("TestFrameHandle", factory_of("TestFrameHandle"));
+  registry.add("TestStream", factory_of("TestStream"));
+  bool ok = true;
+
+  TLOG() << "Exact matches...";
+  ok &= check(lookup("TestFrame") == "TestFrame", "TestFrame creates TestFrame");
+  ok &= check(lookup("TestFrameHandle") == "TestFrameHandle",
+              "TestFrameHandle creates TestFrameHandle, not the earlier registered TestFrame it contains");
+
+  TLOG() << "Substring fallback...";
+  ok &= check(lookup("TestStreamV2") == "TestStream", "TestStreamV2 creates TestStream");
+  ok &= check(lookup("TestFrameHandleV2") == "TestFrame",
+              "TestFrameHandleV2 creates the first registered name it contains, TestFrame");
+  ok &= check(lookup("TestStreamTestFrame") == "TestFrame",
+              "TestStreamTestFrame follows the registration order, not the position in the data type");
+
+  TLOG() << "Unknown data type...";
+  ok &= check(registry.create("TestUnknown", "test_conn") == nullptr && lookup("TestUnknown").empty(),
+              "TestUnknown creates nothing");
+
+  TLOG() << "Registered data types...";
+  auto data_types = registry.get_data_types();
+  ok &= check(data_types.find("TestFrame, TestFrameHandle, TestStream") != std::string::npos,
+              "listed in registration order: " + data_types);
+
+  TLOG() << (ok ? "Passed." : "Failed!");
+  return ok ? 0 : 1;
+}
@@ -39,7 +39,7 @@ struct USER_PAYLOAD_STRUCT
 
 using LatencyBuffer = folly::ProducerConsumerQueue<USER_PAYLOAD_STRUCT>;
 
-inline std::function<void(const felix::packetformat::chunk& chunk)>
+inline std::function<bool(const felix::packetformat::chunk& chunk)>
 payloadToBuffer(std::unique_ptr<LatencyBuffer>& buffer)
 {
   return [&](const felix::packetformat::chunk& chunk) {
@@ -51,6 +51,7 @@ payloadToBuffer(std::unique_ptr<LatencyBuffer>& buffer)
     // Only dump if possible
     if (chunk.length() != USER_PAYLOAD_SIZE) {
       // scream?
+      return true;
     } else {
       USER_PAYLOAD_STRUCT payload;
       uint32_t bytes_copied_chunk = 0; // NOLINT
@@ -64,8 +65,10 @@ payloadToBuffer(std::unique_ptr<LatencyBuffer>& buffer)
       }
       if (!buffer->write(std::move(payload))) {
         // Buffer full
+        return false;
       }
     }
+    return true;
   };
 }
 
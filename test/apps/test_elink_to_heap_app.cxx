@@ -45,7 +45,7 @@ struct PayloadWrapper
 
 using LatencyBuffer = folly::ProducerConsumerQueue<PayloadWrapper>;
 
-inline std::function<void(const felix::packetformat::chunk& chunk)>
+inline std::function<bool(const felix::packetformat::chunk& chunk)>
 payloadToBuffer(std::unique_ptr<LatencyBuffer>& buffer)
 {
   return [&](const felix::packetformat::chunk& chunk) {
@@ -62,7 +62,7 @@ payloadToBuffer(std::unique_ptr<LatencyBuffer>& buffer)
       bytes_copied_chunk += subchunk_sizes[i];
     }
     PayloadWrapper payload_wrapper(chunk_length, payload);
-    buffer->write(std::move(payload_wrapper));
+    return buffer->write(std::move(payload_wrapper));
   };
 }
 
@@ -0,0 +1,88 @@
+/**
+ * @file test_emulated_dma_app.cxx Test application for
+ * EmulatedDMASource. Runs a CardWrapper on the emulated DMA at a given rate,
+ * counting the blocks its DMA processor delivers, and reports the achieved
+ * throughput.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "CardWrapper.hpp"
+#include "EmulatedDMASource.hpp"
+
+#include "logging/Logging.hpp"
+
+#include "packetformat/block_format.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dunedaq::flxlibs;
+
+int
+main(int argc, char** argv)
+{
+  // Rate in MB/s (0 means as fast as possible), and optional block template file
+  double rate_mbs = (argc > 1) ? std::stod(argv[1]) : 0.;
+  std::string template_file = (argc > 2) ? argv[2] : "";
+
+  const std::vector<unsigned int> elinks{ 0, 64, 128, 192, 256 };
+
+  CardWrapper::Settings settings;
+  settings.dma_memory_size = 256 * 1024 * 1024;
+
+  TLOG() << "Creating CardWrapper on an EmulatedDMASource...";
+  CardWrapper flx(settings, { 0, 1, 2, 3, 4 });
+  auto dma = std::make_unique<EmulatedDMASource>("emu-0", CardWrapper::get_block_size());
+  dma->set_rate(rate_mbs * 1000000.);
+  dma->set_elinks(elinks);
+  if (!template_file.empty()) {
+    dma->load_block_templates(template_file);
+  }
+  flx.set_dma_source(std::move(dma));
+
+  // Count the delivered blocks per elink. A single DMA descriptor: a single processor thread calls the handler.
+  std::array<std::size_t, 2048> elink_block_counters{};
+  std::atomic<std::size_t> block_counter{ 0 };
+  std::function<void(uint64_t, std::size_t, uint64_t, std::size_t)> count_blocks = // NOLINT
+    [&](uint64_t first_block_addr, std::size_t num_blocks, uint64_t /*window_ns*/, std::size_t /*dma_index*/) { // NOLINT
+      for (std::size_t i = 0; i < num_blocks; ++i) {
+        const auto* block = felix::packetformat::block_from_bytes(
+          reinterpret_cast<const char*>(first_block_addr + i * CardWrapper::get_block_size())); // NOLINT
+        elink_block_counters[block->elink]++;
+      }
+      block_counter.fetch_add(num_blocks, std::memory_order_relaxed);
+    };
+  flx.set_block_batch_handler(count_blocks);
+
+  TLOG() << "Configure CardWrapper...";
+  flx.configure();
+
+  TLOG() << "Start CardWrapper, application will terminate in 10s...";
+  auto t0 = std::chrono::steady_clock::now();
+  flx.start();
+  std::this_thread::sleep_for(std::chrono::seconds(10));
+
+  TLOG() << "Stop CardWrapper...";
+  flx.stop();
+  auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  auto num_blocks = block_counter.load();
+  TLOG() << "Number of blocks DMA-d: " << num_blocks << " -> "
+         << num_blocks * CardWrapper::get_block_size() / seconds / 1000000. << " MB/s. Per elink: ";
+  bool all_elinks_seen = true;
+  for (auto elink : elinks) {
+    TLOG() << "  elink(" << std::to_string(elink) << "): " << std::to_string(elink_block_counters[elink]);
+    all_elinks_seen = all_elinks_seen && elink_block_counters[elink] > 0;
+  }
+
+  TLOG() << "Exiting.";
+  return (num_blocks > 0 && all_elinks_seen) ? 0 : 1;
+}
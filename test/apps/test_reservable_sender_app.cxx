@@ -0,0 +1,199 @@
+/**
+ * @file test_reservable_sender_app.cxx Test application for the in place
+ * assembly of fixed size payloads. Sends a chunk split into subchunks
+ * through FixsizedChunkPolicy into a ring buffer sink implementing
+ * ReservableSender, and checks it is copied once, into the reserved slot,
+ * without any payload being constructed, copied, moved or sent. Then checks
+ * the by value send into a plain sink, and the drop on a full ring.
+ *
+ * This is part of the DUNE DAQ Application Framework, copyright 2020.
+ * Licensing/copyright details are in the COPYING file that you should have
+ * received with this code.
+ */
+#include "flxlibs/AvailableParserOperations.hpp"
+#include "flxlibs/ReservableSender.hpp"
+
+#include "iomanager/Sender.hpp"
+#include "logging/Logging.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace dunedaq::flxlibs;
+
+namespace {
+
+constexpr std::size_t frame_size = 5568; // DAPHNE frame
+
+// Counts its constructions, copies and moves
+struct TestFrame
+{
+  TestFrame() { ++s_constructed; }
+  TestFrame(const TestFrame& other)
+  {
+    std::memcpy(data, other.data, frame_size);
+    ++s_copied;
+  }
+  TestFrame(TestFrame&& other) noexcept
+  {
+    std::memcpy(data, other.data, frame_size);
+    ++s_moved;
+  }
+  TestFrame& operator=(const TestFrame&) = delete;
+  TestFrame& operator=(TestFrame&&) = delete;
+
+  static void reset_counters() { s_constructed = s_copied = s_moved = 0; }
+
+  char data[frame_size];
+
+  inline static std::size_t s_constructed = 0;
+  inline static std::size_t s_copied = 0;
+  inline static std::size_t s_moved = 0;
+};
+
+// Ring buffer sink: payloads are either sent by value, or assembled in the reserved slot and committed
+class RingSender
+  : public dunedaq::iomanager::SenderConcept<TestFrame>
+  , public ReservableSender<TestFrame>
+{
+public:
+  explicit RingSender(std::size_t capacity)
+    : SenderConcept<TestFrame>(dunedaq::iomanager::ConnectionId{ "ring_sink", "TestFrame" })
+    , m_slots(capacity)
+  {}
+
+  void send(TestFrame&& frame, timeout_t timeout) override { try_send(std::move(frame), timeout); }
+  bool try_send(TestFrame&& frame, timeout_t /*timeout*/) override
+  {
+    ++m_num_sent;
+    TestFrame* slot = reserve(std::chrono::milliseconds(0));
+    if (slot == nullptr) {
+      return false;
+    }
+    new (slot) TestFrame(std::move(frame));
+    commit();
+    return true;
+  }
+  void send_with_topic(TestFrame&& frame, timeout_t timeout, std::string /*topic*/) override
+  {
+    send(std::move(frame), timeout);
+  }
+  bool is_ready_for_sending(timeout_t /*timeout*/) override { return m_num_committed < m_slots.size(); }
+
+  TestFrame* reserve(std::chrono::milliseconds /*timeout*/) override
+  {
+    return m_num_committed < m_slots.size() ? &m_slots[m_num_committed] : nullptr;
+  }
+  void commit() override { ++m_num_committed; }
+
+  const TestFrame& front() const { return m_slots.front(); }
+  std::size_t get_num_sent() const { return m_num_sent; }
+  std::size_t get_num_committed() const { return m_num_committed; }
+
+private:
+  std::vector<TestFrame> m_slots;
+  std::size_t m_num_sent{ 0 };
+  std::size_t m_num_committed{ 0 };
+};
+
+// A plain sink, without reserve and commit
+class ValueSender : public dunedaq::iomanager::SenderConcept<TestFrame>
+{
+public:
+  ValueSender()
+    : SenderConcept<TestFrame>(dunedaq::iomanager::ConnectionId{ "value_sink", "TestFrame" })
+  {}
+
+  void send(TestFrame&& frame, timeout_t timeout) override { try_send(std::move(frame), timeout); }
+  bool try_send(TestFrame&& frame, timeout_t /*timeout*/) override
+  {
+    m_frames.emplace_back(std::move(frame));
+    return true;
+  }
+  void send_with_topic(TestFrame&& frame, timeout_t timeout, std::string /*topic*/) override
+  {
+    send(std::move(frame), timeout);
+  }
+  bool is_ready_for_sending(timeout_t /*timeout*/) override { return true; }
+
+  std::vector<TestFrame> m_frames;
+};
+
+// The subchunk accessors of felix::packetformat::chunk, over a chunk split in three like one spanning blocks
+struct TestChunk
+{
+  explicit TestChunk(const std::vector<char>& bytes)
+    : m_data{ bytes.data(), bytes.data() + 1000, bytes.data() + 4000 }
+    , m_lengths{ 1000, 3000, static_cast<unsigned>(bytes.size()) - 4000 }
+    , m_length(bytes.size())
+  {}
+
+  std::size_t length() const { return m_length; }
+  const char* const* subchunks() const { return m_data.data(); }
+  const unsigned* subchunk_lengths() const { return m_lengths.data(); }
+  unsigned subchunk_number() const { return m_data.size(); }
+
+  std::array<const char*, 3> m_data;
+  std::array<unsigned, 3> m_lengths;
+  std::size_t m_length;
+};
+
+bool
+check(bool condition, const std::string& what)
+{
+  TLOG() << (condition ? "  OK: " : "  FAILED: ") << what;
+  return condition;
+}
+
+} // namespace
+
+int
+main(int /*argc*/, char** /*argv*/)
+{
+  std::vector<char> bytes(frame_size);
+  for (std::size_t i = 0; i < bytes.size(); ++i) {
+    bytes[i] = static_cast<char>(i * 7 + 3);
+  }
+  TestChunk chunk(bytes);
+  const auto timeout = std::chrono::milliseconds(0);
+  bool ok = true;
+
+  TLOG() << "In place assembly into a ReservableSender...";
+  auto ring = std::make_shared<RingSender>(1);
+  std::shared_ptr<dunedaq::iomanager::SenderConcept<TestFrame>> sink = ring;
+  // As StaticParserImpl::set_sink finds it
+  auto* reservable_sink = dynamic_cast<ReservableSender<TestFrame>*>(sink.get());
+  ok &= check(reservable_sink != nullptr, "the ring sink is reservable");
+  TestFrame::reset_counters();
+  ok &= check(parsers::FixsizedChunkPolicy::chunk(chunk, sink, reservable_sink, nullptr, timeout, 0),
+              "the chunk is delivered");
+  ok &= check(ring->get_num_committed() == 1 && ring->get_num_sent() == 0, "it is committed, not sent");
+  ok &= check(TestFrame::s_constructed == 0 && TestFrame::s_copied == 0 && TestFrame::s_moved == 0,
+              "no payload is constructed, copied or moved");
+  ok &= check(std::memcmp(ring->front().data, bytes.data(), frame_size) == 0, "the slot holds the chunk");
+
+  TLOG() << "Full ring...";
+  ok &= check(!parsers::FixsizedChunkPolicy::chunk(chunk, sink, reservable_sink, nullptr, timeout, 0),
+              "the chunk is dropped");
+  ok &= check(ring->get_num_committed() == 1, "nothing more is committed");
+
+  TLOG() << "By value send into a plain sink...";
+  auto values = std::make_shared<ValueSender>();
+  std::shared_ptr<dunedaq::iomanager::SenderConcept<TestFrame>> value_sink = values;
+  values->m_frames.reserve(1);
+  TestFrame::reset_counters();
+  ReservableSender<TestFrame>* no_reservable_sink = nullptr;
+  ok &= check(parsers::FixsizedChunkPolicy::chunk(chunk, value_sink, no_reservable_sink, nullptr, timeout, 0),
+              "the chunk is delivered");
+  ok &= check(TestFrame::s_constructed == 1 && TestFrame::s_moved == 1, "a payload is built, then moved");
+  ok &= check(values->m_frames.size() == 1 && std::memcmp(values->m_frames[0].data, bytes.data(), frame_size) == 0,
+              "the sink holds the chunk");
+
+  TLOG() << (ok ? "Passed." : "Failed!");
+  return ok ? 0 : 1;
+}
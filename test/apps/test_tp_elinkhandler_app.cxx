@@ -132,6 +132,7 @@ main(int argc, char* argv[])
         first = false;
       }
     }
+    return true;
   };
 
   bool firstTPchunk = true;
@@ -141,6 +142,7 @@ main(int argc, char* argv[])
   uint64_t total_counter = 0;
   tpparser.process_chunk_func = [&](const felix::packetformat::chunk& chunk) {
     ++total_counter;
+    bool delivered = true;
     if (firstTPchunk) {
       auto subchunk_data = chunk.subchunks();
       auto subchunk_sizes = chunk.subchunk_lengths();
@@ -162,9 +164,7 @@ main(int argc, char* argv[])
           subchunk_data[i], subchunk_sizes[i], static_cast<void*>(payload), bytes_copied_chunk, chunk_length);
         bytes_copied_chunk += subchunk_sizes[i];
       }
-      if (!tpbuffer->write(std::move(payload_struct))) {
-        // Buffer full
-      }
+      delivered = tpbuffer->write(std::move(payload_struct)); // false: buffer full
 
       if ((uint32_t)(rwtpp->m_head.m_crate_no) == 21) { // RS FIXME -> read from cmdline the list of signatures loaded to EMU
         ++good_counter;
@@ -182,6 +182,7 @@ main(int argc, char* argv[])
         amount++;
       }
     }
+    return delivered;
   };
   tphandler->start(cmd_params);
 